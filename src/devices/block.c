@@ -4,6 +4,36 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
+
+/* Requests are queued per device and carried out by a dispatch
+   thread, one per device, in C-LOOK order: the queue is kept
+   sorted by sector, and the dispatcher serves the lowest sector
+   at or past where the last transfer ended, wrapping around to
+   the lowest sector in the queue when there is none.  Requests
+   for consecutive sectors in the same direction are merged into
+   a single driver transfer if the driver supports it.
+
+   Devices with a `remap' operation, such as partitions, have no
+   queue of their own.  Their requests go on the queue of the
+   underlying device, so that they are sorted and merged with
+   everything else bound for the same disk.
+
+   Synchronous devices, such as RAM disks, have no queue either.
+   Their requests are carried out in block_submit() itself.
+
+   Each device keeps a `struct blkstat' of statistics.  Counts,
+   sequentiality, and latency go to the device a request was
+   submitted to, so that, say, swap and file system partitions
+   on the same disk can be told apart.  Queue depth and transfer
+   counts go to the device that queues it.  Latency is measured
+   in CPU cycles, with the time-stamp counter. */
 
 /* A block device. */
 struct block
@@ -17,8 +47,21 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct blkstat stats;               /* Statistics, except NAME and
+                                           ROLE; see block_get_stats(). */
+    block_sector_t next_sector;         /* Sector after last request. */
+
+    /* Kernel copy of user buffers; see transfer_sync(). */
+    struct lock bounce_lock;            /* Protects BOUNCE. */
+    uint8_t *bounce;                    /* BLOCK_MERGE_MAX sectors. */
+
+    /* Request queue.  Unused if OPS has a remap function or is
+       synchronous. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct condition queue_cond;        /* Signaled when QUEUE gains a request. */
+    struct list queue;                  /* Pending requests, sorted by sector. */
+    size_t queue_len;                   /* Number of requests in QUEUE. */
+    block_sector_t head;                /* Sector after the last transfer. */
   };
 
 /* List of all block devices. */
@@ -28,6 +71,7 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void dispatch (void *block_);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -113,6 +157,166 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Returns true if request A's sector is less than B's. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+  return a->sector < b->sector;
+}
+
+/* Records in the statistics for the device R was submitted to
+   that R has completed. */
+static void
+account_completion (struct block_request *r)
+{
+  struct blkstat *st = &r->block->stats;
+  uint64_t latency = rdtsc () - r->start;
+  uint64_t x;
+  enum intr_level old_level;
+  int bucket = 0;
+
+  for (x = latency; x > 1 && bucket < BLKSTAT_BUCKETS - 1; x >>= 1)
+    bucket++;
+
+  old_level = intr_disable ();
+  st->latency_sum += latency;
+  if (latency > st->latency_max)
+    st->latency_max = latency;
+  st->latency_hist[bucket]++;
+  intr_set_level (old_level);
+}
+
+/* Queues request R on BLOCK and returns without waiting for it.
+   R->complete is called, in BLOCK's dispatch thread, once the
+   transfer is done.  If BLOCK is synchronous, the transfer is
+   done and R->complete called before returning. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  enum intr_level old_level;
+
+  check_sector (block, r->sector);
+  ASSERT (is_kernel_vaddr (r->buffer));
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+  ASSERT (r->complete != NULL);
+
+  r->block = block;
+  r->start = rdtsc ();
+  old_level = intr_disable ();
+  if (r->write)
+    {
+      block->stats.write_cnt++;
+      block->stats.write_bytes += BLOCK_SECTOR_SIZE;
+    }
+  else
+    {
+      block->stats.read_cnt++;
+      block->stats.read_bytes += BLOCK_SECTOR_SIZE;
+    }
+  if (r->sector == block->next_sector)
+    block->stats.seq_cnt++;
+  else
+    block->stats.random_cnt++;
+  block->next_sector = r->sector + 1;
+  intr_set_level (old_level);
+
+  while (block->ops->remap != NULL)
+    {
+      block = block->ops->remap (block->aux, &r->sector);
+      check_sector (block, r->sector);
+    }
+
+  if (block->ops->synchronous)
+    {
+      old_level = intr_disable ();
+      block->stats.transfer_cnt++;
+      intr_set_level (old_level);
+      if (r->write)
+        block->ops->write (block->aux, r->sector, r->buffer);
+      else
+        block->ops->read (block->aux, r->sector, r->buffer);
+      account_completion (r);
+      r->complete (r);
+      return;
+    }
+
+  lock_acquire (&block->queue_lock);
+  block->queue_len++;
+  block->stats.queue_cnt++;
+  block->stats.queue_sum += block->queue_len;
+  if (block->queue_len > block->stats.queue_max)
+    block->stats.queue_max = block->queue_len;
+  list_insert_ordered (&block->queue, &r->elem, request_less, NULL);
+  cond_signal (&block->queue_cond, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Completion function for synchronous requests. */
+static void
+wake_submitter (struct block_request *r)
+{
+  sema_up (r->aux);
+}
+
+/* Transfers the CNT sectors starting at SECTOR on BLOCK to or
+   from BUFFER, depending on WRITE, and waits for them.  They are
+   all queued before the first is dispatched, so they can be
+   merged.
+
+   The dispatch thread doesn't run in our address space, so a
+   BUFFER in user memory is copied through BLOCK's bounce buffer
+   here, in the caller's context.  Such transfers take turns at
+   the bounce buffer, which is allocated once, in
+   block_register(), rather than per transfer. */
+static void
+transfer_sync (struct block *block, block_sector_t sector, void *buffer,
+               size_t cnt, bool write)
+{
+  struct block_request r[BLOCK_MERGE_MAX];
+  struct semaphore done;
+  uint8_t *bounce = NULL;
+  size_t i;
+
+  if (!is_kernel_vaddr (buffer))
+    {
+      lock_acquire (&block->bounce_lock);
+      bounce = block->bounce;
+    }
+  trace (write ? TRACE_BLOCK_WRITE : TRACE_BLOCK_READ, sector, cnt,
+         trace_pack_name (block->name));
+
+  sema_init (&done, 0);
+  while (cnt > 0)
+    {
+      size_t n = cnt < BLOCK_MERGE_MAX ? cnt : BLOCK_MERGE_MAX;
+      uint8_t *kbuf = bounce != NULL ? bounce : buffer;
+
+      if (bounce != NULL && write)
+        memcpy (bounce, buffer, n * BLOCK_SECTOR_SIZE);
+      for (i = 0; i < n; i++)
+        {
+          r[i].sector = sector + i;
+          r[i].buffer = kbuf + i * BLOCK_SECTOR_SIZE;
+          r[i].write = write;
+          r[i].complete = wake_submitter;
+          r[i].aux = &done;
+          block_submit (block, &r[i]);
+        }
+      for (i = 0; i < n; i++)
+        sema_down (&done);
+      if (bounce != NULL && !write)
+        memcpy (buffer, bounce, n * BLOCK_SECTOR_SIZE);
+      sector += n;
+      buffer = (uint8_t *) buffer + n * BLOCK_SECTOR_SIZE;
+      cnt -= n;
+    }
+  if (bounce != NULL)
+    lock_release (&block->bounce_lock);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -120,9 +324,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer_sync (block, sector, buffer, 1, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +335,103 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  transfer_sync (block, sector, (void *) buffer, 1, true);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     void *buffer, size_t cnt)
+{
+  transfer_sync (block, sector, buffer, cnt, false);
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      const void *buffer, size_t cnt)
+{
+  transfer_sync (block, sector, (void *) buffer, cnt, true);
+}
+
+/* Removes from BLOCK's queue, which must not be empty, the next
+   request in C-LOOK order, together with up to BLOCK_MERGE_MAX - 1
+   requests that continue it, and stores them in R.  Returns the
+   number of requests stored. */
+static size_t
+next_requests (struct block *block, struct block_request *r[])
+{
+  struct list_elem *e;
+  size_t cnt = 0;
+
+  ASSERT (!list_empty (&block->queue));
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    if (list_entry (e, struct block_request, elem)->sector >= block->head)
+      break;
+  if (e == list_end (&block->queue))
+    e = list_begin (&block->queue);
+
+  r[cnt++] = list_entry (e, struct block_request, elem);
+  e = list_remove (e);
+  if (block->ops->transfer != NULL)
+    while (cnt < BLOCK_MERGE_MAX && e != list_end (&block->queue))
+      {
+        struct block_request *next = list_entry (e, struct block_request,
+                                                 elem);
+        if (next->sector != r[cnt - 1]->sector + 1
+            || next->write != r[0]->write)
+          break;
+        r[cnt++] = next;
+        e = list_remove (e);
+      }
+  block->head = r[cnt - 1]->sector + 1;
+  block->queue_len -= cnt;
+  return cnt;
+}
+
+/* Dispatch thread for BLOCK_: carries out queued requests
+   forever. */
+static void
+dispatch (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct block_request *r[BLOCK_MERGE_MAX];
+      size_t cnt, i;
+
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->queue))
+        cond_wait (&block->queue_cond, &block->queue_lock);
+      cnt = next_requests (block, r);
+      block->stats.transfer_cnt++;
+      lock_release (&block->queue_lock);
+
+      if (cnt > 1)
+        {
+          void *buffers[BLOCK_MERGE_MAX];
+          for (i = 0; i < cnt; i++)
+            buffers[i] = r[i]->buffer;
+          block->ops->transfer (block->aux, r[0]->sector, buffers, cnt,
+                                r[0]->write);
+        }
+      else if (r[0]->write)
+        block->ops->write (block->aux, r[0]->sector, r[0]->buffer);
+      else
+        block->ops->read (block->aux, r[0]->sector, r[0]->buffer);
+
+      for (i = 0; i < cnt; i++)
+        {
+          account_completion (r[i]);
+          r[i]->complete (r[i]);
+        }
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,10 +455,72 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Returns the role BLOCK has been assigned, or BLOCK's type if
+   none. */
+static enum block_type
+block_role (struct block *block)
+{
+  int i;
+
+  for (i = 0; i < BLOCK_ROLE_CNT; i++)
+    if (block_by_role[i] == block)
+      return i;
+  return block->type;
+}
+
+/* Copies BLOCK's statistics into *ST. */
+void
+block_get_stats (struct block *block, struct blkstat *st)
+{
+  enum intr_level old_level = intr_disable ();
+  *st = block->stats;
+  intr_set_level (old_level);
+
+  strlcpy (st->name, block->name, sizeof st->name);
+  strlcpy (st->role, block_type_name (block_role (block)), sizeof st->role);
+}
+
+/* Prints the I/O statistics of BLOCK, if it has seen any. */
+static void
+print_io_stats (struct block *block)
+{
+  struct blkstat st;
+  uint64_t req_cnt;
+  int i;
+
+  block_get_stats (block, &st);
+  req_cnt = st.read_cnt + st.write_cnt;
+  if (req_cnt > 0)
+    {
+      printf ("%s: %llu bytes read, %llu bytes written, "
+              "%llu%% sequential\n",
+              st.name, st.read_bytes, st.write_bytes,
+              st.seq_cnt * 100 / req_cnt);
+      printf ("%s: latency avg %llu, max %llu cycles;",
+              st.name, st.latency_sum / req_cnt, st.latency_max);
+      for (i = 0; i < BLKSTAT_BUCKETS; i++)
+        if (st.latency_hist[i] > 0)
+          printf (" 2^%d:%"PRIu32, i, st.latency_hist[i]);
+      printf ("\n");
+    }
+  if (st.transfer_cnt > 0)
+    {
+      printf ("%s: %llu transfers", st.name, st.transfer_cnt);
+      if (st.queue_cnt > 0)
+        printf (", queue depth avg %llu.%llu, max %"PRIu32,
+                st.queue_sum / st.queue_cnt,
+                st.queue_sum * 10 / st.queue_cnt % 10, st.queue_max);
+      printf ("\n");
+    }
+}
+
+/* Prints statistics for each block device used for a Pintos
+   role, then I/O statistics for every device that has done
+   any. */
 void
 block_print_stats (void)
 {
+  struct list_elem *e;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
@@ -173,9 +530,13 @@ block_print_stats (void)
         {
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  block->stats.read_cnt, block->stats.write_cnt);
         }
     }
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    print_io_stats (list_entry (e, struct block, list_elem));
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -198,8 +559,24 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  memset (&block->stats, 0, sizeof block->stats);
+  block->next_sector = 0;
+  ASSERT (BLOCK_MERGE_MAX * BLOCK_SECTOR_SIZE <= PGSIZE);
+  lock_init (&block->bounce_lock);
+  lock_set_name (&block->bounce_lock, "bounce");
+  block->bounce = palloc_get_page (0);
+  if (block->bounce == NULL)
+    PANIC ("Failed to allocate bounce buffer for %s", block->name);
+  lock_init (&block->queue_lock);
+  lock_set_name (&block->queue_lock, block->name);
+  cond_init (&block->queue_cond);
+  list_init (&block->queue);
+  block->queue_len = 0;
+  block->head = 0;
+  if (ops->remap == NULL && !ops->synchronous
+      && thread_create (block->name, PRI_DEFAULT, dispatch, block)
+         == TID_ERROR)
+    PANIC ("Failed to start dispatch thread for %s", block->name);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -1,8 +1,11 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <blkstat.h>
+#include <list.h>
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -56,11 +59,47 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, void *,
+                          size_t cnt);
+void block_write_multiple (struct block *, block_sector_t, const void *,
+                           size_t cnt);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
+void block_get_stats (struct block *, struct blkstat *);
 void block_print_stats (void);
+
+/* Asynchronous requests. */
+
+struct block_request;
+
+/* Called in the device's dispatch thread, or in the submitting
+   thread for a synchronous device, when request R has
+   completed. */
+typedef void block_complete_func (struct block_request *r);
+
+/* A request to transfer one sector.  Owned by the block layer
+   from block_submit() until its COMPLETE function is called. */
+struct block_request
+  {
+    struct list_elem elem;              /* Element in device queue. */
+    block_sector_t sector;              /* Sector to transfer. */
+    void *buffer;                       /* BLOCK_SECTOR_SIZE bytes, in
+                                           kernel memory. */
+    bool write;                         /* Write BUFFER, or read into it? */
+    block_complete_func *complete;      /* Completion callback. */
+    void *aux;                          /* For COMPLETE's use. */
+
+    /* Set by block_submit(), for statistics. */
+    struct block *block;                /* Device submitted to. */
+    uint64_t start;                     /* Time of submission. */
+  };
+
+void block_submit (struct block *, struct block_request *);
+
+/* Maximum number of requests merged into one driver transfer. */
+#define BLOCK_MERGE_MAX 8
 
 /* Lower-level interface to block device drivers. */
 
@@ -68,6 +107,24 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfers CNT consecutive sectors, at most
+       BLOCK_MERGE_MAX, starting at the given sector, to or from
+       BUFFERS[0] through BUFFERS[CNT - 1], as one operation. */
+    void (*transfer) (void *aux, block_sector_t, void **buffers,
+                      size_t cnt, bool write);
+
+    /* Optional.  For a device that is a window onto another one,
+       such as a partition, returns the underlying device and
+       translates *SECTOR to a sector on it.  Requests are then
+       queued on the underlying device. */
+    struct block *(*remap) (void *aux, block_sector_t *sector);
+
+    /* If true, requests are carried out at once in the thread
+       that submits them, without a queue or dispatch thread.
+       For devices that gain nothing from scheduling, such as a
+       RAM disk. */
+    bool synchronous;
   };
 
 struct block *block_register (const char *name, enum block_type,
@@ -8,10 +8,20 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   If the PCI bus has a bus-master IDE controller, as the PIIX
+   that QEMU emulates does, sectors are transferred by DMA: the
+   driver hands the controller a table of physical memory regions
+   and sleeps until the completion interrupt, instead of moving
+   every word through the data register itself.  Otherwise it
+   falls back to programmed I/O.  See "Programming Interface for
+   Bus Master IDE Controller", revision 1.0. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -30,10 +40,25 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, relative to the channel's
+   bus master base. */
+#define bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)    /* Command. */
+#define bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)     /* Status. */
+#define bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)       /* PRD table address. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* 1=device to memory, 0=memory to device. */
+
+/* Bus master Status Register bits. */
+#define BM_STA_ERR 0x02         /* Error; write 1 to clear. */
+#define BM_STA_INTR 0x04        /* Interrupt; write 1 to clear. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +74,19 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* A physical region descriptor: one entry in the table that
+   tells the bus master where to transfer data.  A region must
+   not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Byte count. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +95,7 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool dma;                   /* Transfer by DMA? */
   };
 
 /* An ATA channel (aka controller).
@@ -72,6 +111,11 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    /* Bus mastering, if BM_BASE is nonzero. */
+    uint16_t bm_base;           /* Bus master base I/O port. */
+    uint8_t bm_last_status;     /* Bus master status at last interrupt. */
+    struct prd *prdt;           /* PRD table, one page. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -85,7 +129,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -95,6 +139,12 @@ static bool wait_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
+static uint16_t find_bus_master (void);
+static void dma_transfer (struct ata_disk *, block_sector_t,
+                          void **buffers, size_t cnt, bool write);
+static void pio_read (struct ata_disk *, block_sector_t, void *);
+static void pio_write (struct ata_disk *, block_sector_t, const void *);
+
 static void interrupt_handler (struct intr_frame *);
 
 /* Initialize the disk subsystem and detect disks. */
@@ -102,6 +152,7 @@ void
 ide_init (void) 
 {
   size_t chan_no;
+  uint16_t bm_base = find_bus_master ();
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
@@ -124,8 +175,19 @@ ide_init (void)
           NOT_REACHED ();
         }
       lock_init (&c->lock);
+      lock_set_name (&c->lock, c->name);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+
+      /* Set up bus mastering.  The secondary channel's registers
+         follow the primary's. */
+      c->bm_base = 0;
+      if (bm_base != 0)
+        {
+          c->prdt = palloc_get_page (0);
+          if (c->prdt != NULL)
+            c->bm_base = bm_base + chan_no * 8;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +198,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -286,8 +349,10 @@ identify_ata_device (struct ata_disk *d)
   capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
+  d->dma = d->channel->bm_base != 0 && (id[49 * 2 + 1] & 1) != 0;
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -347,12 +412,10 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  if (d->dma)
+    dma_transfer (d, sec_no, &buffer, 1, false);
+  else
+    pio_read (d, sec_no, buffer);
   lock_release (&c->lock);
 }
 
@@ -366,34 +429,89 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  void *buf = (void *) buffer;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  if (d->dma)
+    dma_transfer (d, sec_no, &buf, 1, true);
+  else
+    pio_write (d, sec_no, buffer);
+  lock_release (&c->lock);
+}
+
+/* Transfers the CNT sectors starting at SEC_NO on disk D to or
+   from BUFFERS, one buffer per sector.  With DMA this is a single
+   command; otherwise the sectors are moved one at a time. */
+static void
+ide_transfer (void *d_, block_sector_t sec_no, void **buffers, size_t cnt,
+              bool write)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t i;
+
+  ASSERT (cnt <= BLOCK_MERGE_MAX);
+  lock_acquire (&c->lock);
+  if (d->dma)
+    dma_transfer (d, sec_no, buffers, cnt, write);
+  else
+    for (i = 0; i < cnt; i++)
+      if (write)
+        pio_write (d, sec_no + i, buffers[i]);
+      else
+        pio_read (d, sec_no + i, buffers[i]);
   lock_release (&c->lock);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_transfer,
+    NULL,
+    false
   };
-
+
+/* Reads sector SEC_NO from disk D into BUFFER by programmed I/O.
+   The caller must hold the channel lock. */
+static void
+pio_read (struct ata_disk *d, block_sector_t sec_no, void *buffer) 
+{
+  struct channel *c = d->channel;
+  select_sector (d, sec_no, 1);
+  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+  sema_down (&c->completion_wait);
+  if (!wait_while_busy (d))
+    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
+  input_sector (c, buffer);
+}
+
+/* Writes sector SEC_NO to disk D from BUFFER by programmed I/O.
+   The caller must hold the channel lock. */
+static void
+pio_write (struct ata_disk *d, block_sector_t sec_no, const void *buffer) 
+{
+  struct channel *c = d->channel;
+  select_sector (d, sec_no, 1);
+  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+  if (!wait_while_busy (d))
+    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
+  output_sector (c, buffer);
+  sema_down (&c->completion_wait);
+}
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= 256);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -430,6 +548,135 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* Bus-master DMA. */
+
+/* PCI configuration space ports, for configuration mechanism
+   #1 of the PCI Local Bus Specification. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* PCI configuration registers that we use. */
+#define PCI_REG_COMMAND 0x04    /* Command (low 16 bits). */
+#define PCI_REG_CLASS 0x08      /* Class, subclass, prog. i/f, revision. */
+#define PCI_REG_BAR4 0x20       /* Base address 4: bus master ports. */
+
+/* PCI Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* Enable bus mastering. */
+
+/* Returns the 32-bit register REG of PCI function FUNC of device
+   DEV on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) 
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Sets the 32-bit register REG of PCI function FUNC of device
+   DEV on bus 0 to VALUE. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) 
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that can be a bus
+   master, enables bus mastering on it, and returns the base
+   I/O port of its bus master registers.  Returns 0 if there is
+   no such controller. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t class = pci_read_config (dev, func, PCI_REG_CLASS);
+        uint32_t bar;
+
+        /* Class 1 (mass storage), subclass 1 (IDE), with the
+           bus-master bit set in the programming interface. */
+        if (class == 0xffffffff || (class >> 16) != 0x0101
+            || (class & 0x8000) == 0)
+          continue;
+        bar = pci_read_config (dev, func, PCI_REG_BAR4);
+        if ((bar & 1) == 0 || (bar & 0xfffc) == 0)
+          continue;
+
+        pci_write_config (dev, func, PCI_REG_COMMAND,
+                          pci_read_config (dev, func, PCI_REG_COMMAND)
+                          | PCI_CMD_IO | PCI_CMD_MASTER);
+        return bar & 0xfffc;
+      }
+  return 0;
+}
+
+/* Appends to PRD table entry *PRD and those after it a
+   description of the BLOCK_SECTOR_SIZE bytes at BUFFER, which
+   must be a kernel address, and advances *PRD past them.  Splits
+   the sector at a page boundary: kernel pages are physically
+   contiguous, but a region must not cross a 64 kB boundary. */
+static void
+add_prd (struct prd **prd, uint8_t *buffer) 
+{
+  size_t size = BLOCK_SECTOR_SIZE;
+
+  ASSERT (is_kernel_vaddr (buffer));
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (buffer);
+      if (chunk > size)
+        chunk = size;
+      (*prd)->addr = vtop (buffer);
+      (*prd)->size = chunk;
+      (*prd)->flags = 0;
+      (*prd)++;
+      buffer += chunk;
+      size -= chunk;
+    }
+}
+
+/* Reads the CNT sectors starting at SEC_NO on disk D into
+   BUFFERS, one buffer per sector, or writes them from BUFFERS if
+   WRITE is true, with a single DMA command.  The buffers must be
+   kernel addresses, which the block layer guarantees.  The
+   caller sleeps until the completion interrupt and must hold the
+   channel lock. */
+static void
+dma_transfer (struct ata_disk *d, block_sector_t sec_no, void **buffers,
+              size_t cnt, bool write) 
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BM_CMD_READ;
+  struct prd *prd = c->prdt;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (cnt >= 1 && cnt <= BLOCK_MERGE_MAX);
+
+  for (i = 0; i < cnt; i++)
+    add_prd (&prd, buffers[i]);
+  prd[-1].flags = PRD_EOT;
+
+  /* Program the bus master, then the drive, then start the
+     transfer. */
+  outl (bm_prdt (c), vtop (c->prdt));
+  outb (bm_command (c), direction);
+  outb (bm_status (c), BM_STA_ERR | BM_STA_INTR);
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (bm_command (c), direction | BM_CMD_START);
+  sema_down (&c->completion_wait);
+  outb (bm_command (c), direction);
+
+  if ((c->bm_last_status & BM_STA_ERR) || (inb (reg_status (c)) & STA_ERR))
+    PANIC ("%s: DMA %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -513,6 +760,13 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
+            /* With bus mastering, the controller also latches the
+               interrupt and any DMA error; save and clear them. */
+            if (c->bm_base != 0)
+              {
+                c->bm_last_status = inb (bm_status (c));
+                outb (bm_status (c), BM_STA_ERR | BM_STA_INTR);
+              }
             inb (reg_status (c));               /* Acknowledge interrupt. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
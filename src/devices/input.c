@@ -1,16 +1,20 @@
 #include "devices/input.h"
 #include <debug.h>
-#include "devices/intq.h"
+#include "devices/ringbuf.h"
 #include "devices/serial.h"
 
+/* Input buffer size, in bytes. */
+#define INPUT_BUFSIZE 256
+
 /* Stores keys from the keyboard and serial port. */
-static struct intq buffer;
+static struct ringbuf buffer;
+static uint8_t buffer_storage[INPUT_BUFSIZE];
 
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
-  intq_init (&buffer);
+  ringbuf_init (&buffer, buffer_storage, sizeof buffer_storage);
 }
 
 /* Adds a key to the input buffer.
@@ -19,9 +23,9 @@ void
 input_putc (uint8_t key) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT (!intq_full (&buffer));
+  ASSERT (!ringbuf_full (&buffer));
 
-  intq_putc (&buffer, key);
+  ringbuf_putc (&buffer, key);
   serial_notify ();
 }
 
@@ -34,7 +38,7 @@ input_getc (void)
   uint8_t key;
 
   old_level = intr_disable ();
-  key = intq_getc (&buffer);
+  key = ringbuf_getc (&buffer);
   serial_notify ();
   intr_set_level (old_level);
   
@@ -48,5 +52,5 @@ bool
 input_full (void) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return intq_full (&buffer);
+  return ringbuf_full (&buffer);
 }
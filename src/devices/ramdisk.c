@@ -0,0 +1,100 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A RAM disk: a block device whose sectors live in kernel
+   memory.  It has no seek time and no transfer time, so running
+   the file system or swap on it shows their CPU costs apart from
+   those of the disk.
+
+   The storage is a table of pages obtained from the kernel pool
+   when the device is created, so that it never has to allocate
+   memory, and never fail, while carrying out a request.  The
+   pages don't need to be contiguous. */
+
+/* Number of sectors in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Number of kernel pool pages left free for the rest of the
+   kernel. */
+#define RAMDISK_RESERVE_PAGES 64
+
+/* The RAM disk's pages. */
+static uint8_t **pages;
+static size_t page_cnt;
+
+static struct block_operations ramdisk_operations;
+
+/* Returns the address of SECTOR on the RAM disk. */
+static uint8_t *
+sector_addr (block_sector_t sector)
+{
+  ASSERT (sector / SECTORS_PER_PAGE < page_cnt);
+  return pages[sector / SECTORS_PER_PAGE]
+         + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE;
+}
+
+/* Creates a RAM disk of SIZE_KB kB, rounded up to a whole number
+   of pages, and registers it as block device "rd0" of type
+   BLOCK_RAW.  Its contents are initially all zeros.  It can then
+   be given a role with the -filesys, -scratch, or -swap kernel
+   option.  Panics if there isn't enough memory. */
+void
+ramdisk_init (size_t size_kb)
+{
+  size_t free_cnt = palloc_free_cnt (0);
+  size_t i;
+
+  page_cnt = DIV_ROUND_UP (size_kb, PGSIZE / 1024);
+  if (page_cnt == 0)
+    return;
+  if (free_cnt < RAMDISK_RESERVE_PAGES
+      || page_cnt > free_cnt - RAMDISK_RESERVE_PAGES)
+    PANIC ("ramdisk: %zu kB requested but only %zu kB available",
+           size_kb, (free_cnt > RAMDISK_RESERVE_PAGES
+                     ? free_cnt - RAMDISK_RESERVE_PAGES : 0) * PGSIZE / 1024);
+
+  pages = malloc (page_cnt * sizeof *pages);
+  if (pages == NULL)
+    PANIC ("ramdisk: out of memory for page table");
+  for (i = 0; i < page_cnt; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        PANIC ("ramdisk: out of memory");
+    }
+
+  block_register ("rd0", BLOCK_RAW, "RAM disk", page_cnt * SECTORS_PER_PAGE,
+                  &ramdisk_operations, NULL);
+}
+
+/* Reads sector SECTOR from the RAM disk into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_read (void *aux UNUSED, block_sector_t sector, void *buffer)
+{
+  memcpy (buffer, sector_addr (sector), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes sector SECTOR to the RAM disk from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *aux UNUSED, block_sector_t sector, const void *buffer)
+{
+  memcpy (sector_addr (sector), buffer, BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    NULL,
+    NULL,
+    true
+  };
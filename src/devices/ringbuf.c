@@ -0,0 +1,188 @@
+#include "devices/ringbuf.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/thread.h"
+
+/* A thread waiting on a ring buffer. */
+struct waiter
+  {
+    struct list_elem elem;      /* Element in a wait list. */
+    struct thread *thread;      /* The waiting thread. */
+    size_t want;                /* Bytes of data or room wanted. */
+  };
+
+static void wait (struct list *, size_t want);
+static void wake (struct list *, size_t avail);
+
+/* Initializes RB to use the SIZE bytes at BUF, where SIZE is a
+   power of 2, as its storage. */
+void
+ringbuf_init (struct ringbuf *rb, void *buf, size_t size) 
+{
+  ASSERT (buf != NULL);
+  ASSERT (size > 0 && (size & (size - 1)) == 0);
+
+  rb->buf = buf;
+  rb->size = size;
+  rb->head = rb->tail = 0;
+  list_init (&rb->readers);
+  list_init (&rb->writers);
+}
+
+/* Returns the number of bytes in RB. */
+size_t
+ringbuf_used (const struct ringbuf *rb) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return rb->head - rb->tail;
+}
+
+/* Returns the number of bytes that can be added to RB. */
+size_t
+ringbuf_room (const struct ringbuf *rb) 
+{
+  return rb->size - ringbuf_used (rb);
+}
+
+/* Returns true if RB is empty, false otherwise. */
+bool
+ringbuf_empty (const struct ringbuf *rb) 
+{
+  return ringbuf_used (rb) == 0;
+}
+
+/* Returns true if RB is full, false otherwise. */
+bool
+ringbuf_full (const struct ringbuf *rb) 
+{
+  return ringbuf_room (rb) == 0;
+}
+
+/* Removes a byte from RB and returns it.
+   If RB is empty, sleeps until a byte is added.
+   When called from an interrupt handler, RB must not be empty. */
+uint8_t
+ringbuf_getc (struct ringbuf *rb) 
+{
+  uint8_t byte;
+
+  ringbuf_wait_data (rb, 1);
+  ringbuf_get_n (rb, &byte, 1);
+  return byte;
+}
+
+/* Adds BYTE to the end of RB.
+   If RB is full, sleeps until a byte is removed.
+   When called from an interrupt handler, RB must not be full. */
+void
+ringbuf_putc (struct ringbuf *rb, uint8_t byte) 
+{
+  ringbuf_wait_room (rb, 1);
+  ringbuf_put_n (rb, &byte, 1);
+}
+
+/* Removes up to N bytes from RB into DST without sleeping.
+   Returns the number of bytes removed. */
+size_t
+ringbuf_get_n (struct ringbuf *rb, void *dst_, size_t n) 
+{
+  uint8_t *dst = dst_;
+  size_t ofs, chunk;
+
+  if (n > ringbuf_used (rb))
+    n = ringbuf_used (rb);
+  if (n == 0)
+    return 0;
+
+  /* Copy in at most two pieces, split where the buffer wraps. */
+  ofs = rb->tail & (rb->size - 1);
+  chunk = rb->size - ofs < n ? rb->size - ofs : n;
+  memcpy (dst, rb->buf + ofs, chunk);
+  memcpy (dst + chunk, rb->buf, n - chunk);
+  rb->tail += n;
+
+  wake (&rb->writers, ringbuf_room (rb));
+  return n;
+}
+
+/* Adds up to N bytes from SRC to RB without sleeping.
+   Returns the number of bytes added. */
+size_t
+ringbuf_put_n (struct ringbuf *rb, const void *src_, size_t n) 
+{
+  const uint8_t *src = src_;
+  size_t ofs, chunk;
+
+  if (n > ringbuf_room (rb))
+    n = ringbuf_room (rb);
+  if (n == 0)
+    return 0;
+
+  ofs = rb->head & (rb->size - 1);
+  chunk = rb->size - ofs < n ? rb->size - ofs : n;
+  memcpy (rb->buf + ofs, src, chunk);
+  memcpy (rb->buf, src + chunk, n - chunk);
+  rb->head += n;
+
+  wake (&rb->readers, ringbuf_used (rb));
+  return n;
+}
+
+/* Sleeps until RB holds at least N bytes, which must not exceed
+   its capacity.  Must not be called from an interrupt handler,
+   unless RB already holds N bytes. */
+void
+ringbuf_wait_data (struct ringbuf *rb, size_t n) 
+{
+  ASSERT (n <= rb->size);
+  while (ringbuf_used (rb) < n)
+    wait (&rb->readers, n);
+}
+
+/* Sleeps until RB has room for at least N bytes, which must not
+   exceed its capacity.  Must not be called from an interrupt
+   handler, unless RB already has room for N bytes. */
+void
+ringbuf_wait_room (struct ringbuf *rb, size_t n) 
+{
+  ASSERT (n <= rb->size);
+  while (ringbuf_room (rb) < n)
+    wait (&rb->writers, n);
+}
+
+/* Blocks the current thread on LIST until woken up by wake()
+   with at least WANT bytes available. */
+static void
+wait (struct list *list, size_t want) 
+{
+  struct waiter w;
+
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  w.thread = thread_current ();
+  w.want = want;
+  list_push_back (list, &w.elem);
+  thread_block ();
+}
+
+/* Wakes up every thread on LIST that wants no more than AVAIL
+   bytes. */
+static void
+wake (struct list *list, size_t avail) 
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  for (e = list_begin (list); e != list_end (list); )
+    {
+      struct waiter *w = list_entry (e, struct waiter, elem);
+      if (w->want <= avail)
+        {
+          e = list_remove (e);
+          thread_unblock (w->thread);
+        }
+      else
+        e = list_next (e);
+    }
+}
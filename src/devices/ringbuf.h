@@ -0,0 +1,47 @@
+#ifndef DEVICES_RINGBUF_H
+#define DEVICES_RINGBUF_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* A ring buffer of bytes shared between kernel threads and
+   external interrupt handlers.  It replaces the old fixed-size
+   "interrupt queue": the capacity is chosen by the owner and may
+   be any power of 2, data can be moved in bulk, and any number
+   of threads may wait for data or for room at once.
+
+   Ring buffer functions can be called from kernel threads or
+   from external interrupt handlers.  Except for ringbuf_init(),
+   interrupts must be off in either case.  Locks and condition
+   variables can't protect data shared with an interrupt handler,
+   so waiting is done by blocking threads directly, as in a
+   monitor whose lock is "interrupts off". */
+
+/* A ring buffer. */
+struct ringbuf
+  {
+    uint8_t *buf;               /* Storage, SIZE bytes. */
+    size_t size;                /* Capacity, a power of 2. */
+    size_t head;                /* Total bytes ever added. */
+    size_t tail;                /* Total bytes ever removed. */
+    struct list readers;        /* Threads waiting for data. */
+    struct list writers;        /* Threads waiting for room. */
+  };
+
+void ringbuf_init (struct ringbuf *, void *buf, size_t size);
+size_t ringbuf_used (const struct ringbuf *);
+size_t ringbuf_room (const struct ringbuf *);
+bool ringbuf_empty (const struct ringbuf *);
+bool ringbuf_full (const struct ringbuf *);
+
+uint8_t ringbuf_getc (struct ringbuf *);
+void ringbuf_putc (struct ringbuf *, uint8_t);
+size_t ringbuf_get_n (struct ringbuf *, void *, size_t);
+size_t ringbuf_put_n (struct ringbuf *, const void *, size_t);
+void ringbuf_wait_data (struct ringbuf *, size_t);
+void ringbuf_wait_room (struct ringbuf *, size_t);
+
+#endif /* devices/ringbuf.h */
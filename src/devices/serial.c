@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
+#include "devices/ringbuf.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +37,14 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+
+/* Size of the 16550A transmit FIFO, in bytes. */
+#define TX_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -51,11 +59,15 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, filled by serial_putbuf() and drained
+   by the interrupt handler. */
+#define TXQ_SIZE 4096
+static struct ringbuf txq;
+static uint8_t txq_buf[TXQ_SIZE];
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void putc_poll_queued (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -71,7 +83,7 @@ init_poll (void)
   outb (FCR_REG, 0);                    /* Disable FIFO. */
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  ringbuf_init (&txq, txq_buf, sizeof txq_buf);
   mode = POLL;
 } 
 
@@ -88,6 +100,12 @@ serial_init_queue (void)
   ASSERT (mode == POLL);
 
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+
+  /* With the FIFOs on, each transmit interrupt can hand the UART
+     up to TX_FIFO_SIZE bytes instead of one.  The receive FIFO
+     keeps its default trigger level of 1 byte so that keystrokes
+     aren't delayed. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
   mode = QUEUE;
   old_level = intr_disable ();
   write_ier ();
@@ -97,34 +115,56 @@ serial_init_queue (void)
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) 
+{
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUF to the serial port.  In queued mode,
+   copies as much of BUF into the transmit queue as fits at a
+   time, with interrupts disabled once per copy rather than once
+   per byte. */
+void
+serial_putbuf (const uint8_t *buf, size_t n) 
 {
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*buf++); 
     }
   else 
-    {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
-        {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
-        }
-
-      intq_putc (&txq, byte); 
-      write_ier ();
-    }
+    for (;;)
+      {
+        /* Queue as much as fits and kick the transmitter. */
+        size_t cnt = ringbuf_put_n (&txq, buf, n);
+        buf += cnt;
+        n -= cnt;
+        write_ier ();
+        if (n == 0)
+          break;
+
+        if (old_level == INTR_OFF)
+          {
+            /* Interrupts are off and the transmit queue is
+               full.  If we wanted to wait for the queue to
+               empty, we'd have to reenable interrupts.
+               That's impolite, so we'll send a character via
+               polling instead. */
+            putc_poll_queued (); 
+          }
+        else
+          {
+            /* Wait for the interrupt handler to make room for
+               the rest, or to drain half the queue, so that we
+               refill it in big pieces. */
+            ringbuf_wait_room (&txq, n < TXQ_SIZE / 2 ? n : TXQ_SIZE / 2);
+          }
+      }
   
   intr_set_level (old_level);
 }
@@ -135,8 +175,8 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!ringbuf_empty (&txq))
+    putc_poll_queued ();
   intr_set_level (old_level);
 }
 
@@ -182,7 +222,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!ringbuf_empty (&txq))
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -205,6 +245,14 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Transmits the oldest byte in the transmit queue, which must
+   not be empty, by polling. */
+static void
+putc_poll_queued (void) 
+{
+  putc_poll (ringbuf_getc (&txq));
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
@@ -218,10 +266,15 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* As long as we have bytes to transmit, and the transmit FIFO
+     is empty, refill it. */
+  while (!ringbuf_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
+    {
+      uint8_t chunk[TX_FIFO_SIZE];
+      size_t i, cnt = ringbuf_get_n (&txq, chunk, sizeof chunk);
+      for (i = 0; i < cnt; i++)
+        outb (THR_REG, chunk[i]);
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
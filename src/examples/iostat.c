@@ -0,0 +1,28 @@
+/* iostat.c
+
+   Prints I/O statistics for each block device that has done
+   any I/O. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+int
+main (void)
+{
+  struct blkstat st;
+  int i;
+
+  printf ("%-8s %-8s %10s %10s %5s %12s %12s\n", "device", "role",
+          "kB read", "kB written", "%seq", "avg cycles", "max cycles");
+  for (i = 0; blkstat (i, &st); i++)
+    {
+      uint64_t req_cnt = st.read_cnt + st.write_cnt;
+      if (req_cnt == 0)
+        continue;
+      printf ("%-8s %-8s %10llu %10llu %5llu %12llu %12llu\n",
+              st.name, st.role, st.read_bytes / 1024, st.write_bytes / 1024,
+              st.seq_cnt * 100 / req_cnt, st.latency_sum / req_cnt,
+              st.latency_max);
+    }
+  return EXIT_SUCCESS;
+}
@@ -1,5 +1,6 @@
 #include "filesys/inode.h"
 #include <list.h>
+#include <advice.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
@@ -7,6 +8,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 
@@ -102,11 +104,29 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of in-memory inodes. */
+static struct kmem_cache *inode_cache;
+
+/* Constructs a cached inode.  Its locks are always released
+   before the inode goes back to the cache, so they only need to
+   be initialized once. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+  lock_init (&inode->extension_lock);
+  lock_set_name (&inode->extension_lock, "inode extension");
+  lock_init (&inode->entries_lock);
+  lock_set_name (&inode->entries_lock, "inode entries");
+}
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode),
+                                   inode_ctor);
 }
 
 
@@ -356,7 +376,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -366,10 +386,7 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  /*new*/
-  lock_init(&inode->extension_lock);
-  lock_init(&inode->entries_lock);
-  /*end new*/
+  inode->advice = ADV_NORMAL;
   block_read (fs_device, inode->sector, &inode->data);
   return inode;
 }
@@ -455,7 +472,7 @@ inode_close (struct inode *inode)
 	  */ 
         }
     ending:
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
@@ -739,3 +756,19 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Records ADVICE, one of ADV_NORMAL, ADV_SEQUENTIAL, or
+   ADV_RANDOM, as the expected access pattern for INODE.  It
+   lasts as long as INODE stays open. */
+void
+inode_set_advice (struct inode *inode, int advice)
+{
+  inode->advice = advice;
+}
+
+/* Returns INODE's access pattern hint. */
+int
+inode_get_advice (const struct inode *inode)
+{
+  return inode->advice;
+}
@@ -34,6 +34,7 @@ struct inode
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
+    int advice;                         /* ADV_* hint from fadvise(). */
     /*new*/
     struct lock extension_lock; /*needed to avoid race 
 during extension of a file/directory pointed by this inode */
@@ -58,5 +59,7 @@ off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_set_advice (struct inode *, int advice);
+int inode_get_advice (const struct inode *);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,11 @@
+#ifndef __LIB_ADVICE_H
+#define __LIB_ADVICE_H
+
+/* Access pattern hints for fadvise() and madvise(). */
+#define ADV_NORMAL      0       /* No particular pattern. */
+#define ADV_SEQUENTIAL  1       /* Read ahead; data is used once. */
+#define ADV_RANDOM      2       /* Don't read ahead. */
+#define ADV_WILLNEED    3       /* Bring the data in now. */
+#define ADV_DONTNEED    4       /* Push the data out now. */
+
+#endif /* lib/advice.h */
@@ -0,0 +1,42 @@
+#ifndef __LIB_BLKSTAT_H
+#define __LIB_BLKSTAT_H
+
+#include <stdint.h>
+
+/* Number of buckets in a latency histogram.  Bucket I counts
+   requests that took from 2**I to 2**(I+1) - 1 CPU cycles,
+   except that bucket 0 also counts those that took 0 cycles and
+   the last bucket also counts anything longer. */
+#define BLKSTAT_BUCKETS 40
+
+/* I/O statistics for a block device, as returned by blkstat(). */
+struct blkstat
+  {
+    char name[16];              /* Device name, e.g. "hda2". */
+    char role[8];               /* Role, e.g. "swap", or else type. */
+
+    uint64_t read_cnt;          /* Sectors read. */
+    uint64_t write_cnt;         /* Sectors written. */
+    uint64_t read_bytes;        /* Bytes read. */
+    uint64_t write_bytes;       /* Bytes written. */
+    uint64_t seq_cnt;           /* Requests for the sector after the
+                                   previous request's. */
+    uint64_t random_cnt;        /* All other requests. */
+
+    /* Queue statistics.  A device without a queue of its own,
+       such as a partition, leaves these 0 and its requests are
+       counted on the device that queues them. */
+    uint64_t transfer_cnt;      /* Driver transfers. */
+    uint64_t queue_cnt;         /* Requests queued. */
+    uint64_t queue_sum;         /* Sum of queue depths seen by each
+                                   request on arrival, itself
+                                   included. */
+    uint32_t queue_max;         /* Largest such depth. */
+
+    /* Latency, in CPU cycles, from submission to completion. */
+    uint64_t latency_sum;       /* Total. */
+    uint64_t latency_max;       /* Longest. */
+    uint32_t latency_hist[BLKSTAT_BUCKETS];   /* Log2 histogram. */
+  };
+
+#endif /* lib/blkstat.h */
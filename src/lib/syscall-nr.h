@@ -28,7 +28,21 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Vectored and positional I/O. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_COPY_FILE_RANGE,        /* Copy data between files in the kernel. */
+
+    /* Access pattern hints. */
+    SYS_FADVISE,                /* Advise about a file's access pattern. */
+    SYS_MADVISE,                /* Advise about a memory range's access pattern. */
+
+    /* Statistics. */
+    SYS_BLKSTAT                 /* Get a block device's I/O statistics. */
   };
 
 #endif /* lib/syscall-nr.h */
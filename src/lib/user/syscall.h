@@ -3,6 +3,9 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <uio.h>
+#include <advice.h>
+#include <blkstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +48,18 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Vectored and positional I/O. */
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+
+/* Access pattern hints. */
+int fadvise (int fd, unsigned offset, unsigned length, int advice);
+int madvise (void *addr, unsigned length, int advice);
+
+/* Statistics. */
+bool blkstat (int idx, struct blkstat *);
+
 #endif /* lib/user/syscall.h */
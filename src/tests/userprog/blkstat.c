@@ -0,0 +1,64 @@
+/* Finds the file system device with blkstat(), writes a file,
+   and checks that the device's statistics account for the
+   write. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Stores the statistics of the file system device in *ST.
+   Fails if there is none. */
+static void
+get_filesys_stats (struct blkstat *st)
+{
+  int i;
+
+  for (i = 0; blkstat (i, st); i++)
+    if (!strcmp (st->role, "filesys"))
+      return;
+  fail ("no file system device");
+}
+
+/* Returns the number of requests counted in ST's latency
+   histogram. */
+static uint64_t
+hist_total (const struct blkstat *st)
+{
+  uint64_t total = 0;
+  int i;
+
+  for (i = 0; i < BLKSTAT_BUCKETS; i++)
+    total += st->latency_hist[i];
+  return total;
+}
+
+void
+test_main (void) 
+{
+  static char buf[4096];
+  struct blkstat before, after;
+  int handle;
+
+  CHECK (!blkstat (-1, &before), "blkstat(-1) fails");
+  get_filesys_stats (&before);
+  msg ("found file system device");
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  memset (buf, 'a', sizeof buf);
+  CHECK (write (handle, buf, sizeof buf) == sizeof buf, "write \"test.txt\"");
+  close (handle);
+
+  get_filesys_stats (&after);
+  if (after.write_cnt <= before.write_cnt)
+    fail ("write count didn't grow");
+  if (after.write_bytes - before.write_bytes
+      != (after.write_cnt - before.write_cnt) * 512)
+    fail ("bytes written don't match sectors written");
+  if (after.seq_cnt + after.random_cnt != after.read_cnt + after.write_cnt)
+    fail ("sequential and random counts don't add up");
+  if (hist_total (&after) != after.read_cnt + after.write_cnt)
+    fail ("latency histogram doesn't cover every request");
+  msg ("statistics are consistent");
+}
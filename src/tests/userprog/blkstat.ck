@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(blkstat) begin
+(blkstat) blkstat(-1) fails
+(blkstat) found file system device
+(blkstat) create "test.txt"
+(blkstat) open "test.txt"
+(blkstat) write "test.txt"
+(blkstat) statistics are consistent
+(blkstat) end
+blkstat: exit(0)
+EOF
+pass;
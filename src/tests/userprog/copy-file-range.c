@@ -0,0 +1,74 @@
+/* Copies sample.txt into a second file with copy_file_range(),
+   checking that both file positions advance, that a copy running
+   into end of file comes up short, even for a huge length, and
+   that overlapping ranges of one file, bad handles, and
+   directories are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  int src, src2, dst, dir, byte_cnt;
+
+  CHECK (create ("src.txt", size), "create \"src.txt\"");
+  CHECK (create ("dst.txt", 0), "create \"dst.txt\"");
+  CHECK ((src = open ("src.txt")) > 1, "open \"src.txt\"");
+  CHECK ((dst = open ("dst.txt")) > 1, "open \"dst.txt\"");
+  CHECK (write (src, sample, size) == (int) size, "write \"src.txt\"");
+  seek (src, 0);
+
+  byte_cnt = copy_file_range (src, dst, 100);
+  if (byte_cnt != 100)
+    fail ("copy_file_range() returned %d instead of 100", byte_cnt);
+  if (tell (src) != 100 || tell (dst) != 100)
+    fail ("copy_file_range() left positions at %u and %u instead of 100",
+          tell (src), tell (dst));
+  msg ("copy 100 bytes");
+
+  byte_cnt = copy_file_range (src, dst, size);
+  if (byte_cnt != (int) size - 100)
+    fail ("copy_file_range() at end of file returned %d instead of %zu",
+          byte_cnt, size - 100);
+  if (tell (src) != size || tell (dst) != size)
+    fail ("copy_file_range() left positions at %u and %u instead of %zu",
+          tell (src), tell (dst), size);
+  msg ("copy to end of file");
+
+  seek (dst, 0);
+  memset (buf, 0, sizeof buf);
+  if (read (dst, buf, size) != (int) size || memcmp (buf, sample, size))
+    fail ("\"dst.txt\" doesn't match \"src.txt\"");
+  msg ("read back data");
+
+  CHECK ((src2 = open ("src.txt")) > 1, "open \"src.txt\" again");
+  seek (src, 0);
+  seek (src2, 5);
+  if (copy_file_range (src, src2, 10) != -1)
+    fail ("copy_file_range() allowed overlapping ranges");
+  if (tell (src) != 0 || tell (src2) != 5)
+    fail ("refused copy_file_range() moved the file positions");
+  msg ("overlapping copy refused");
+
+  seek (src2, size);
+  byte_cnt = copy_file_range (src, src2, 0xffffffff);
+  if (byte_cnt != (int) size)
+    fail ("copy_file_range() of 0xffffffff bytes returned %d instead of %zu",
+          byte_cnt, size);
+  msg ("huge copy stops at end of file");
+
+  if (copy_file_range (src, 1234, 10) != -1
+      || copy_file_range (1234, dst, 10) != -1)
+    fail ("copy_file_range() accepted a bad handle");
+  CHECK ((dir = open ("/")) > 1, "open \"/\"");
+  if (copy_file_range (src, dir, 10) != -1
+      || copy_file_range (dir, dst, 10) != -1)
+    fail ("copy_file_range() accepted a directory");
+  msg ("bad handles refused");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) create "src.txt"
+(copy-file-range) create "dst.txt"
+(copy-file-range) open "src.txt"
+(copy-file-range) open "dst.txt"
+(copy-file-range) write "src.txt"
+(copy-file-range) copy 100 bytes
+(copy-file-range) copy to end of file
+(copy-file-range) read back data
+(copy-file-range) open "src.txt" again
+(copy-file-range) overlapping copy refused
+(copy-file-range) huge copy stops at end of file
+(copy-file-range) open "/"
+(copy-file-range) bad handles refused
+(copy-file-range) end
+copy-file-range: exit(0)
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Writes sample.txt in pieces with writev(), reads it back in
+   pieces with readv() and pread(), and overwrites part of it
+   with pwrite(), checking that positional I/O doesn't move the
+   file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  char buf[sizeof sample];
+  struct iovec iov[3];
+  int handle, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 10;
+  iov[2].iov_len = size - 10;
+  byte_cnt = writev (handle, iov, 3);
+  if (byte_cnt != (int) size)
+    fail ("writev() returned %d instead of %zu", byte_cnt, size);
+
+  memset (buf, 0, sizeof buf);
+  byte_cnt = pread (handle, buf, size, 0);
+  if (byte_cnt != (int) size || memcmp (buf, sample, size))
+    fail ("pread() didn't read back what writev() wrote");
+  if (tell (handle) != size)
+    fail ("pread() moved the file position to %u", tell (handle));
+
+  CHECK (pwrite (handle, "XYZ", 3, 1) == 3, "pwrite \"XYZ\"");
+  memcpy (sample + 1, "XYZ", 3);
+
+  seek (handle, 0);
+  memset (buf, 0, sizeof buf);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 7;
+  iov[1].iov_base = buf + 7;
+  iov[1].iov_len = sizeof buf - 7;
+  byte_cnt = readv (handle, iov, 2);
+  if (byte_cnt != (int) size)
+    fail ("readv() returned %d instead of %zu", byte_cnt, size);
+  if (memcmp (buf, sample, size))
+    fail ("readv() read back the wrong data");
+  msg ("read back data");
+}
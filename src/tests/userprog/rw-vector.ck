@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rw-vector) begin
+(rw-vector) create "test.txt"
+(rw-vector) open "test.txt"
+(rw-vector) pwrite "XYZ"
+(rw-vector) read back data
+(rw-vector) end
+rw-vector: exit(0)
+EOF
+pass;
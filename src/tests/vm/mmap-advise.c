@@ -0,0 +1,64 @@
+/* Gives access pattern hints for a memory mapping and checks
+   that pushing its page out and bringing it back in keeps its
+   contents, including a modification.  Then reads a mapping
+   much larger than user memory, which the kernel is run with -ul
+   to limit, sequentially, so that read-ahead has to compete with
+   eviction. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Size of the big mapping, in pages. */
+#define BIG_PAGES 128
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  char *big = (char *) 0x20000000;
+  static char page[4096];
+  int handle;
+  mapid_t map;
+  size_t i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, actual)) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (fadvise (handle, 0, 0, ADV_SEQUENTIAL) == 0, "fadvise sequential");
+  CHECK (madvise (actual, 4096, ADV_WILLNEED) == 0, "madvise willneed");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+
+  actual[0] = 'X';
+  CHECK (madvise (actual, 4096, ADV_DONTNEED) == 0, "madvise dontneed");
+  if (actual[0] != 'X' || memcmp (actual + 1, sample + 1, strlen (sample) - 1))
+    fail ("mmap'd data changed after madvise(ADV_DONTNEED)");
+
+  CHECK (madvise (actual + 4096, 4096, ADV_WILLNEED) == -1,
+         "madvise on unmapped memory fails");
+  munmap (map);
+  close (handle);
+
+  CHECK (create ("big.dat", 0), "create \"big.dat\"");
+  CHECK ((handle = open ("big.dat")) > 1, "open \"big.dat\"");
+  for (i = 0; i < BIG_PAGES; i++)
+    {
+      memset (page, i, sizeof page);
+      if (write (handle, page, sizeof page) != (int) sizeof page)
+        fail ("write of page %zu failed", i);
+    }
+  CHECK ((map = mmap (handle, big)) != MAP_FAILED, "mmap \"big.dat\"");
+  CHECK (fadvise (handle, 0, 0, ADV_SEQUENTIAL) == 0,
+         "fadvise \"big.dat\" sequential");
+  for (i = 0; i < BIG_PAGES; i++)
+    {
+      memset (page, i, sizeof page);
+      if (memcmp (big + i * sizeof page, page, sizeof page))
+        fail ("page %zu of \"big.dat\" has bad data", i);
+    }
+  msg ("read \"big.dat\" sequentially");
+  munmap (map);
+  close (handle);
+}
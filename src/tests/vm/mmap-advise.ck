@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-advise) begin
+(mmap-advise) open "sample.txt"
+(mmap-advise) mmap "sample.txt"
+(mmap-advise) fadvise sequential
+(mmap-advise) madvise willneed
+(mmap-advise) madvise dontneed
+(mmap-advise) madvise on unmapped memory fails
+(mmap-advise) create "big.dat"
+(mmap-advise) open "big.dat"
+(mmap-advise) mmap "big.dat"
+(mmap-advise) fadvise "big.dat" sequential
+(mmap-advise) read "big.dat" sequentially
+(mmap-advise) end
+EOF
+pass;
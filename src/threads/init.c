@@ -20,8 +20,10 @@
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -34,11 +36,14 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
 #include "vm/swap.h"
 #include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/vma.h"
 
 struct hash frames;
 struct swap swap;
@@ -57,13 +62,35 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk: Size of RAM disk to create, in kB, or 0 for none. */
+static size_t ramdisk_kb;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -nopse: Map kernel memory with 4 kB pages only? */
+static bool no_pse;
+
+/* -nopge: Don't mark kernel mappings global? */
+static bool no_pge;
+
+/* -trace: Where to dump the event trace, or a null pointer to
+   disable tracing. */
+static const char *trace_dest;
+
+/* -profile: Take a profiling sample every this many timer ticks,
+   or 0 to disable profiling. */
+static int profile_interval;
+
+/* Feature flags in EDX for CPUID leaf 1. */
+#define CPUID_PSE (1u << 3)             /* 4 MB pages. */
+#define CPUID_PGE (1u << 13)            /* Global pages. */
+
 static void bss_init (void);
 static void paging_init (void);
+static uint32_t cpuid_edx (uint32_t leaf);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -103,6 +130,10 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  if (trace_dest != NULL)
+    trace_init (trace_dest);
+  if (profile_interval != 0)
+    profile_init (profile_interval);
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -122,16 +153,22 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+#ifdef USERPROG
+  process_init ();
+#endif
   serial_init_queue ();
   timer_calibrate ();
 
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init ();
+  ramdisk_init (ramdisk_kb);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
 
+  frame_init();
+  vma_init();
   hash_init(&frames, frame_hash, frame_less, NULL);
   swap_init(&swap);
   printf ("Boot complete.\n");
@@ -157,15 +194,35 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CR4 bit that enables 4 MB pages.  See [IA32-v3a] 2.5
+   "Control Registers". */
+#define CR4_PSE 0x00000010
+
+/* CR4 bit that enables global pages. */
+#define CR4_PGE 0x00000080
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports 4 MB pages, each 4 MB region of physical
+   memory that lies entirely within RAM and holds no kernel text
+   is mapped by a single page directory entry, which takes one
+   TLB entry instead of up to 1024.  Kernel text stays in 4 kB
+   pages so that it can remain read-only.  Every process's page
+   directory copies these entries, so the savings apply to
+   kernel accesses from user processes as well. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  uint32_t features = cpuid_edx (1);
+  bool pse = !no_pse && (features & CPUID_PSE) != 0;
+  bool pge = !no_pge && (features & CPUID_PGE) != 0;
+  uint32_t global = pge ? PTE_G : 0;
+  uint32_t cr4;
   extern char _start, _end_kernel_text;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -178,23 +235,55 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (&_end_kernel_text <= vaddr || vaddr + PTSPAN <= &_start))
+        {
+          pd[pde_idx] = pde_create_large_kernel (vaddr, true) | global;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
     }
 
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
-     of the Page Directory". */
+     of the Page Directory".  4 MB pages and global pages must be
+     enabled first if we used any.  Every page directory shares
+     these kernel mappings, so marking them global lets their TLB
+     entries survive the CR3 loads on context switches.  See
+     [IA32-v3a] 3.11 "Translation Lookaside Buffers (TLBs)". */
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (pse)
+    cr4 |= CR4_PSE;
+  if (pge)
+    cr4 |= CR4_PGE;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns the EDX output of CPUID for LEAF.  For leaf 1, that
+   is the feature flags, such as CPUID_PSE and CPUID_PGE.  See
+   [IA32-v2a] "CPUID--CPU Identification". */
+static uint32_t
+cpuid_edx (uint32_t leaf)
+{
+  uint32_t eax, ebx, ecx, edx;
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (leaf));
+  return edx;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -258,6 +347,8 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -267,6 +358,16 @@ parse_options (char **argv)
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
 #endif
+      else if (!strcmp (name, "-nopse"))
+        no_pse = true;
+      else if (!strcmp (name, "-nopge"))
+        no_pge = true;
+      else if (!strcmp (name, "-trace"))
+        trace_dest = value != NULL ? value : "serial";
+      else if (!strcmp (name, "-lockstat"))
+        lock_stats_enabled = true;
+      else if (!strcmp (name, "-profile"))
+        profile_interval = value != NULL ? atoi (value) : 1;
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
@@ -299,6 +400,19 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef VM
+/* Runs the supplemental page table benchmark with the number of
+   pages specified in ARGV[1]. */
+static void
+run_spt_bench (char **argv)
+{
+  int page_cnt = atoi (argv[1]);
+  if (page_cnt <= 0)
+    PANIC ("spt-bench: page count must be positive");
+  page_benchmark (page_cnt);
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -322,6 +436,9 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+#endif
+#ifdef VM
+      {"spt-bench", 2, run_spt_bench},
 #endif
       {NULL, 0, NULL},
     };
@@ -371,6 +488,9 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
+#endif
+#ifdef VM
+          "  spt-bench N        Time page table lookups with N pages mapped.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -383,12 +503,20 @@ usage (void)
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
+          "  -ramdisk=KB        Create a KB kB RAM disk named rd0.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
+          "  -nopse             Map kernel memory with 4 kB pages only.\n"
+          "  -nopge             Don't make kernel TLB entries global.\n"
+          "  -trace[=DEST]      Trace kernel events; dump to DEST at shutdown,\n"
+          "                     `serial' (the default) or `scratch'.\n"
+          "  -lockstat          Collect lock statistics; print at shutdown.\n"
+          "  -profile[=N]       Sample the running code every N timer ticks\n"
+          "                     (default 1) and print a profile at shutdown.\n"
           );
   shutdown_power_off ();
 }
@@ -72,6 +72,7 @@ void
 malloc_init (void) 
 {
   size_t block_size;
+  char name[16];
 
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
     {
@@ -81,6 +82,8 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      snprintf (name, sizeof name, "malloc %zu", block_size);
+      lock_set_name (&d->lock, name);
     }
 }
 
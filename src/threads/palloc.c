@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -36,6 +37,7 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t free_cnt;                    /* Number of free pages. */
     //struct semaphore sema;
 };
 
@@ -45,6 +47,7 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static void add_free_cnt (struct pool *, size_t page_cnt, bool freed);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -85,6 +88,8 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   lock_acquire (&pool->lock);
   //sema_down(&pool->sema);
   page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  if (page_idx != BITMAP_ERROR)
+    add_free_cnt (pool, page_cnt, false);
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -143,7 +148,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
       if(f != NULL)
 	{
 	  hash_delete(&frames, &f->hash_elem);
-	  free(f);
+	  frame_destroy(f);
 	}
       page+=PGSIZE; 
     }
@@ -159,6 +164,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 #endif
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  add_free_cnt (pool, page_cnt, true);
 }
 
 /* Frees the page at PAGE. */
@@ -168,6 +174,81 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Frees the PAGE_CNT single pages whose addresses are in PAGES[],
+   taking each pool's lock only once for the whole batch.  Unlike
+   palloc_free_multiple(), does not touch the frame table: the
+   caller must already have removed any frame entries for user
+   pages. */
+void
+palloc_free_batch (void **pages, size_t page_cnt)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  size_t i, j, freed = 0;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      ASSERT (pg_ofs (pages[i]) == 0);
+#ifndef NDEBUG
+      memset (pages[i], 0xcc, PGSIZE);
+#endif
+    }
+
+  for (j = 0; j < sizeof pools / sizeof *pools; j++)
+    {
+      struct pool *pool = pools[j];
+      bool locked = false;
+
+      size_t pool_cnt = 0;
+
+      for (i = 0; i < page_cnt; i++)
+        if (page_from_pool (pool, pages[i]))
+          {
+            size_t page_idx = pg_no (pages[i]) - pg_no (pool->base);
+            if (!locked)
+              {
+                lock_acquire (&pool->lock);
+                locked = true;
+              }
+            ASSERT (bitmap_test (pool->used_map, page_idx));
+            bitmap_reset (pool->used_map, page_idx);
+            pool_cnt++;
+          }
+      if (locked)
+        {
+          add_free_cnt (pool, pool_cnt, true);
+          lock_release (&pool->lock);
+        }
+      freed += pool_cnt;
+    }
+  ASSERT (freed == page_cnt);
+}
+
+/* Returns the number of free pages in the user pool, if PAL_USER
+   is set in FLAGS, otherwise in the kernel pool.  The count is
+   kept up to date as pages come and go, so this is cheap, but it
+   may be stale by the time the caller acts on it. */
+size_t
+palloc_free_cnt (enum palloc_flags flags)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  return pool->free_cnt;
+}
+
+/* Adjusts POOL's count of free pages by PAGE_CNT, up if FREED is
+   true, otherwise down.  Pages may be freed without the pool's
+   lock, even with interrupts off (see thread_schedule_tail()), so
+   the count is updated with interrupts off instead. */
+static void
+add_free_cnt (struct pool *pool, size_t page_cnt, bool freed)
+{
+  enum intr_level old_level = intr_disable ();
+  if (freed)
+    pool->free_cnt += page_cnt;
+  else
+    pool->free_cnt -= page_cnt;
+  intr_set_level (old_level);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -185,9 +266,11 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
+  lock_set_name (&p->lock, name);
   //sema_init(&p->sema, 1);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  p->free_cnt = page_cnt;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,136 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Sampling CPU profiler.
+
+   With the -profile kernel option, every Nth timer interrupt
+   records the address of the instruction it interrupted.  Counts
+   are kept per address in an open-addressed hash table that is
+   allocated once at boot, so sampling never allocates memory or
+   takes a lock.  Samples from user code are only counted, since
+   they can't be symbolized against the kernel.
+
+   At shutdown, the addresses are printed, most samples first, as
+   "PROFILE ADDRESS COUNT" lines.  utils/pintos-prof turns these
+   into a flat profile by function, using kernel.o.
+
+   The timer interrupt can't interrupt code that runs with
+   interrupts disabled, so time spent there is charged to the
+   instruction that turns them back on. */
+
+/* Number of pages in the hash table. */
+#define PROFILE_PAGES 4
+
+/* Number of slots in the hash table.  A power of 2. */
+#define PROFILE_SLOTS (PROFILE_PAGES * PGSIZE / sizeof (struct sample))
+
+/* Samples at one address. */
+struct sample
+  {
+    uint32_t eip;               /* Address, or 0 if slot is free. */
+    uint32_t cnt;               /* Number of samples. */
+  };
+
+/* Hash table, or a null pointer if not profiling. */
+static struct sample *samples;
+
+/* Sample every INTERVAL ticks; COUNTDOWN ticks remain until the
+   next one. */
+static int interval;
+static int countdown;
+
+/* Statistics. */
+static unsigned long long kernel_cnt;   /* Samples in kernel code. */
+static unsigned long long user_cnt;     /* Samples in user code. */
+static unsigned long long dropped_cnt;  /* Samples lost to a full table. */
+
+/* Begins profiling, sampling every INTERVAL timer ticks. */
+void
+profile_init (int interval_)
+{
+  ASSERT ((PROFILE_SLOTS & (PROFILE_SLOTS - 1)) == 0);
+
+  if (interval_ < 1)
+    PANIC ("-profile: interval must be positive");
+  interval = countdown = interval_;
+  samples = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, PROFILE_PAGES);
+}
+
+/* Counts a sample at EIP in the hash table. */
+static void
+record (uint32_t eip)
+{
+  size_t i, h = (eip * 2654435761u) & (PROFILE_SLOTS - 1);
+
+  for (i = 0; i < PROFILE_SLOTS; i++, h = (h + 1) & (PROFILE_SLOTS - 1))
+    if (samples[h].eip == eip)
+      {
+        samples[h].cnt++;
+        kernel_cnt++;
+        return;
+      }
+    else if (samples[h].eip == 0)
+      {
+        samples[h].eip = eip;
+        samples[h].cnt = 1;
+        kernel_cnt++;
+        return;
+      }
+  dropped_cnt++;
+}
+
+/* Called by the timer interrupt handler with the frame F of the
+   code it interrupted. */
+void
+profile_tick (const struct intr_frame *f)
+{
+  if (samples == NULL || --countdown > 0)
+    return;
+  countdown = interval;
+
+  if (is_user_vaddr ((void *) f->eip))
+    user_cnt++;
+  else
+    record ((uint32_t) f->eip);
+}
+
+/* qsort() comparison function that orders samples by descending
+   count. */
+static int
+compare_samples (const void *a_, const void *b_)
+{
+  const struct sample *a = a_;
+  const struct sample *b = b_;
+  return a->cnt < b->cnt ? 1 : a->cnt > b->cnt ? -1 : 0;
+}
+
+/* Stops profiling and prints the samples, most frequent first.
+   Does nothing if profiling was never enabled. */
+void
+profile_dump (void)
+{
+  enum intr_level old_level;
+  struct sample *table;
+  size_t i;
+
+  /* Once SAMPLES is null, the timer interrupt won't touch the
+     table again. */
+  old_level = intr_disable ();
+  table = samples;
+  samples = NULL;
+  intr_set_level (old_level);
+  if (table == NULL)
+    return;
+
+  qsort (table, PROFILE_SLOTS, sizeof *table, compare_samples);
+  printf ("Profile: %llu kernel samples, %llu user, %llu dropped, "
+          "every %d ticks\n", kernel_cnt, user_cnt, dropped_cnt, interval);
+  for (i = 0; i < PROFILE_SLOTS && table[i].cnt > 0; i++)
+    printf ("PROFILE 0x%08"PRIx32" %"PRIu32"\n", table[i].eip, table[i].cnt);
+}
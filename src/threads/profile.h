@@ -0,0 +1,11 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+struct intr_frame;
+
+/* Sampling profiler.  See profile.c. */
+void profile_init (int interval);
+void profile_tick (const struct intr_frame *);
+void profile_dump (void);
+
+#endif /* threads/profile.h */
@@ -0,0 +1,307 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* An object-cache ("slab") allocator.
+
+   malloc() rounds every request up to a power of 2 and shares
+   one descriptor, and so one lock, among all structures of a
+   similar size.  A 60-byte `struct page' thus occupies a 64-byte
+   block and contends with every other 33- to 64-byte allocation
+   in the kernel.
+
+   A cache instead hands out objects of exactly one size.  Each
+   cache owns a set of slabs, each of which is a single page
+   obtained from the page allocator.  A slab begins with a
+   header, followed by a stack of the indexes of its free
+   objects, followed by the objects themselves:
+
+        +--------+--------------+-----+-----+-----+- - -+
+        | header | free indexes | obj | obj | obj | ... |
+        +--------+--------------+-----+-----+-----+- - -+
+
+   The free list lives outside the objects, so the allocator
+   never writes into an object.  That lets a cache have a
+   constructor: it runs once on every object when the slab is
+   created, and the object is expected to be handed back to
+   kmem_cache_free() in its constructed state (for example, with
+   its locks released).
+
+   Slabs that have at least one free object are kept on the
+   cache's `partial' list.  When a slab becomes entirely free, it
+   is returned to the page allocator, except that one empty slab
+   per cache is kept around so that a single alloc/free pair at a
+   slab boundary doesn't bounce a page back and forth. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Maximum number of caches. */
+#define CACHE_CNT 16
+
+/* An object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size requested by the creator. */
+    size_t slot_size;           /* OBJ_SIZE rounded up for alignment. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or a null pointer. */
+
+    struct lock lock;           /* Protects everything below. */
+    struct list partial;        /* Slabs with at least one free object. */
+    size_t empty_cnt;           /* Number of completely free slabs. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs currently allocated. */
+    size_t in_use;              /* Objects currently allocated. */
+    size_t peak_in_use;         /* Maximum value of IN_USE. */
+    unsigned long long alloc_cnt;       /* Total allocations. */
+  };
+
+/* A slab. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial list. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free_idx[];        /* Stack of free object indexes. */
+  };
+
+/* Our set of caches. */
+static struct kmem_cache caches[CACHE_CNT];
+static size_t cache_cnt;
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+static void *slab_to_obj (struct slab *, size_t idx);
+
+/* Creates and returns a cache of SIZE-byte objects named NAME.
+   If CTOR is non-null, it is called on every object when the
+   slab that holds it is created.  Panics if too many caches
+   exist or if SIZE is too big to fit two objects in a page. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  if (cache_cnt >= CACHE_CNT)
+    PANIC ("kmem_cache_create: too many caches (creating \"%s\")", name);
+  c = &caches[cache_cnt++];
+
+  c->name = name;
+  c->obj_size = size;
+  c->slot_size = ROUND_UP (size, sizeof (void *));
+  c->ctor = ctor;
+
+  /* Fit as many objects as we can after the header and the
+     free-index stack, which grows by two bytes per object. */
+  for (n = (PGSIZE - sizeof (struct slab)) / (c->slot_size + 2); n > 0; n--)
+    {
+      size_t ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                             sizeof (void *));
+      if (ofs + n * c->slot_size <= PGSIZE)
+        {
+          c->obj_ofs = ofs;
+          break;
+        }
+    }
+  if (n < 2)
+    PANIC ("kmem_cache_create: %zu-byte objects are too big for \"%s\"",
+           size, name);
+  c->objs_per_slab = n;
+
+  lock_init (&c->lock);
+  lock_set_name (&c->lock, name);
+  list_init (&c->partial);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->in_use = c->peak_in_use = 0;
+  c->alloc_cnt = 0;
+  return c;
+}
+
+/* Obtains and returns an object from cache C.  If C has a
+   constructor, the object is in its constructed state; otherwise
+   its contents are unspecified.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (c != NULL);
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial))
+    {
+      s = new_slab (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+      c->empty_cnt++;
+    }
+  else
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+
+  if (s->free_cnt == c->objs_per_slab)
+    c->empty_cnt--;
+  obj = slab_to_obj (s, s->free_idx[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Obtains an object from cache C, as kmem_cache_alloc(), and
+   fills it with zeros.  Intended for caches without a
+   constructor. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c)
+{
+  void *obj = kmem_cache_alloc (c);
+  if (obj != NULL)
+    memset (obj, 0, c->obj_size);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to
+   C.  A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - ((uint8_t *) s + c->obj_ofs)) / c->slot_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs.  We
+     can't do this if the object must stay constructed. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  ASSERT (c->in_use > 0);
+  if (s->free_cnt == 0)
+    list_push_front (&c->partial, &s->elem);
+  s->free_idx[s->free_cnt++] = idx;
+  c->in_use--;
+
+  /* If the slab is now entirely unused, give it back, unless
+     it's the only empty slab we have. */
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      if (c->empty_cnt > 0)
+        {
+          list_remove (&s->elem);
+          s->magic = 0;
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+      else
+        c->empty_cnt++;
+    }
+  lock_release (&c->lock);
+}
+
+/* Prints usage statistics for every cache. */
+void
+slab_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < cache_cnt; i++)
+    {
+      struct kmem_cache *c = &caches[i];
+      printf ("Slab %s: %zu-byte objects, %zu in use (peak %zu), "
+              "%zu slabs, %llu allocs\n",
+              c->name, c->obj_size, c->in_use, c->peak_in_use,
+              c->slab_cnt, c->alloc_cnt);
+    }
+}
+
+/* Allocates and initializes a new slab for cache C, which must
+   be locked.  Returns a null pointer if no page is available. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+
+  /* Hand out low-addressed objects first. */
+  for (i = 0; i < c->objs_per_slab; i++)
+    s->free_idx[i] = c->objs_per_slab - i - 1;
+
+  if (c->ctor != NULL)
+    for (i = 0; i < c->objs_per_slab; i++)
+      c->ctor (slab_to_obj (s, i));
+
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ, an object from cache C, is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->slot_size == 0);
+
+  return s;
+}
+
+/* Returns the IDX'th object within slab S. */
+static void *
+slab_to_obj (struct slab *s, size_t idx)
+{
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (idx < s->cache->objs_per_slab);
+  return (uint8_t *) s + s->cache->obj_ofs + idx * s->cache->slot_size;
+}
@@ -28,9 +28,12 @@
 
 #include "threads/synch.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tsc.h"
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -158,6 +161,40 @@ sema_test_helper (void *sema_)
     }
 }
 
+/* Lock statistics.
+
+   With the -lockstat kernel option, every lock acquisition is
+   counted, along with whether it had to wait for another thread,
+   how long it waited, and how long the lock was then held, all
+   in CPU cycles.  Statistics are kept per lock name rather than
+   per lock, so that, for example, all inode locks are counted
+   together, and so that they outlive the locks themselves.
+   Locks without a name share one set of statistics. */
+
+/* Statistics for locks with one name. */
+struct lock_stats
+  {
+    char name[16];                      /* Lock name. */
+    unsigned long long acquire_cnt;     /* Acquisitions. */
+    unsigned long long contended_cnt;   /* Acquisitions that waited. */
+    unsigned long long wait_cycles;     /* Total time waiting. */
+    unsigned long long hold_cycles;     /* Total time held. */
+    unsigned long long hold_max;        /* Longest time held. */
+  };
+
+/* Maximum number of lock names. */
+#define LOCK_NAME_CNT 64
+
+/* Number of locks printed by lock_print_stats(). */
+#define LOCK_REPORT_CNT 10
+
+/* True to collect lock statistics. */
+bool lock_stats_enabled;
+
+/* Statistics by name.  The first entry is for unnamed locks. */
+static struct lock_stats lock_stats[LOCK_NAME_CNT] = {{.name = "(unnamed)"}};
+static size_t lock_name_cnt = 1;
+
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
    is, it is an error for the thread currently holding a lock to
@@ -180,6 +217,73 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->stats = &lock_stats[0];
+  lock->acquired = 0;
+}
+
+/* Gives LOCK the given NAME, for statistics.  Locks with the
+   same name, up to 15 characters, are counted together.  If
+   there are too many names already, LOCK stays unnamed. */
+void
+lock_set_name (struct lock *lock, const char *name)
+{
+  char short_name[sizeof lock_stats[0].name];
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+
+  strlcpy (short_name, name, sizeof short_name);
+  old_level = intr_disable ();
+  for (i = 1; i < lock_name_cnt; i++)
+    if (!strcmp (lock_stats[i].name, short_name))
+      break;
+  if (i == lock_name_cnt && lock_name_cnt < LOCK_NAME_CNT)
+    strlcpy (lock_stats[lock_name_cnt++].name, short_name,
+             sizeof short_name);
+  if (i < lock_name_cnt)
+    lock->stats = &lock_stats[i];
+  intr_set_level (old_level);
+}
+
+/* Records in LOCK's statistics that the running thread has just
+   acquired it after waiting WAIT cycles, if CONTENDED. */
+static void
+count_acquire (struct lock *lock, bool contended, uint64_t wait)
+{
+  struct lock_stats *s = lock->stats;
+  enum intr_level old_level = intr_disable ();
+
+  s->acquire_cnt++;
+  if (contended)
+    {
+      s->contended_cnt++;
+      s->wait_cycles += wait;
+    }
+  lock->acquired = rdtsc ();
+  intr_set_level (old_level);
+}
+
+/* Records in LOCK's statistics that the running thread is about
+   to release it. */
+static void
+count_release (struct lock *lock)
+{
+  struct lock_stats *s = lock->stats;
+  enum intr_level old_level;
+  uint64_t hold;
+
+  if (lock->acquired == 0)
+    return;
+  hold = rdtsc () - lock->acquired;
+  lock->acquired = 0;
+
+  old_level = intr_disable ();
+  s->hold_cycles += hold;
+  if (hold > s->hold_max)
+    s->hold_max = hold;
+  intr_set_level (old_level);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -193,10 +297,31 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *holder;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
-  sema_down (&lock->semaphore);
+
+  holder = lock->holder;
+  if ((trace_enabled || lock_stats_enabled) && holder != NULL)
+    {
+      tid_t holder_tid = holder->tid;
+      uint64_t start = rdtsc ();
+      uint64_t wait;
+
+      sema_down (&lock->semaphore);
+      wait = rdtsc () - start;
+      trace (TRACE_LOCK_WAIT, (uint32_t) lock, holder_tid, wait);
+      if (lock_stats_enabled)
+        count_acquire (lock, true, wait);
+    }
+  else
+    {
+      sema_down (&lock->semaphore);
+      if (lock_stats_enabled)
+        count_acquire (lock, false, 0);
+    }
   lock->holder = thread_current ();
 }
 
@@ -216,7 +341,11 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      if (lock_stats_enabled)
+        count_acquire (lock, false, 0);
+      lock->holder = thread_current ();
+    }
   return success;
 }
 
@@ -231,10 +360,59 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  if (lock_stats_enabled)
+    count_release (lock);
   lock->holder = NULL;
   sema_up (&lock->semaphore);
 }
 
+/* qsort() comparison function that orders lock statistics by
+   descending number of contended acquisitions, then by
+   descending time spent waiting. */
+static int
+compare_contention (const void *a_, const void *b_)
+{
+  const struct lock_stats *a = a_;
+  const struct lock_stats *b = b_;
+
+  if (a->contended_cnt != b->contended_cnt)
+    return a->contended_cnt < b->contended_cnt ? 1 : -1;
+  if (a->wait_cycles != b->wait_cycles)
+    return a->wait_cycles < b->wait_cycles ? 1 : -1;
+  return 0;
+}
+
+/* Prints statistics for the most contended lock names, if
+   statistics were collected. */
+void
+lock_print_stats (void)
+{
+  struct lock_stats sorted[LOCK_NAME_CNT];
+  enum intr_level old_level;
+  size_t cnt, i;
+
+  if (!lock_stats_enabled)
+    return;
+
+  old_level = intr_disable ();
+  cnt = lock_name_cnt;
+  memcpy (sorted, lock_stats, cnt * sizeof *sorted);
+  intr_set_level (old_level);
+
+  qsort (sorted, cnt, sizeof *sorted, compare_contention);
+  printf ("Locks: %zu names, most contended first:\n", cnt);
+  for (i = 0; i < cnt && i < LOCK_REPORT_CNT; i++)
+    {
+      struct lock_stats *s = &sorted[i];
+      if (s->acquire_cnt == 0)
+        break;
+      printf ("  %s: %llu acquires, %llu contended, %llu cycles waiting, "
+              "%llu cycles held (max %llu)\n",
+              s->name, s->acquire_cnt, s->contended_cnt, s->wait_cycles,
+              s->hold_cycles, s->hold_max);
+    }
+}
+
 /* Returns true if the current thread holds LOCK, false
    otherwise.  (Note that testing whether some other thread holds
    a lock would be racy.) */
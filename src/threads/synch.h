@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -22,14 +23,23 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct lock_stats *stats;   /* Statistics, shared by locks of the
+                                   same name; see lock_set_name(). */
+    uint64_t acquired;          /* Time-stamp counter when acquired,
+                                   if collecting statistics. */
   };
 
 void lock_init (struct lock *);
+void lock_set_name (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Lock statistics. */
+extern bool lock_stats_enabled;
+void lock_print_stats (void);
+
 /* Condition variable. */
 struct condition 
   {
@@ -11,9 +11,11 @@
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/syscall.h"
 #endif
 #include "filesys/directory.h"
 
@@ -93,6 +95,7 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
+  lock_set_name (&tid_lock, "tid");
   list_init (&ready_list);
   list_init (&all_list);
   
@@ -316,14 +319,7 @@ thread_exit (void)
 
   // remove all file descriptors
   struct list_elem *e, *next;
-  struct fd_* file_d;
-  for(e = list_begin(&cur->files); e!= list_end(&cur->files);){
-    next = list_remove(e);
-    file_d = list_entry(e, struct fd_, elem);
-    file_close(file_d->file);
-    free(file_d);
-    e = next;
-   }
+  close_all_fds(cur);
 
   // reap all of its children
   struct thread *child;
@@ -331,7 +327,7 @@ thread_exit (void)
     child = list_entry(e, struct thread, child_elem);
     if(child->status == THREAD_ZOMBIE){
       next = list_remove(e);
-      palloc_free_page(child);
+      thread_release(child);
       e = next;
     }
     else
@@ -534,11 +530,13 @@ init_thread (struct thread *t, const char *name, int priority)
   sema_init(&t->wait, 0);
   t->parent = running_thread();
   t->load_child = true;
-  t->next_fd = 2;
+  t->next_mapid = 2;
   t->dead = false;
   list_init(&t->children);
-  list_init(&t->files);
   list_init(&t->map);
+  list_init(&t->vmas);
+  spt_init(&t->pages);
+  page_arena_init(&t->spt_arena);
   /*
   if(t==t->parent){
     printf("\nt->cwd=dir_open_root()\n");
@@ -628,10 +626,24 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_release (prev);
     }
 }
 
+/* Frees T, which must be dead.  If the reaper thread has yet to
+   tear down T's address space, T is freed by the reaper when it
+   finishes instead. */
+void
+thread_release (struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+  if (t->reaping)
+    t->release = true;
+  else
+    palloc_free_page (t);
+  intr_set_level (old_level);
+}
+
 /* Schedules a new process.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
@@ -650,7 +662,10 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      trace (TRACE_SCHEDULE, next->tid, cur->status, 0);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -9,6 +9,7 @@
 #include <hash.h>
 #include "threads/palloc.h"
 #include "filesys/directory.h"
+#include "vm/page.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -104,6 +105,7 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct tlb_batch *tlb_batch;        /* Open TLB flush batch, if any. */
 #endif
 
     /******* NEW VARIABLES *********/
@@ -112,15 +114,24 @@ struct thread
     struct semaphore wait;
     struct thread *parent;
     bool load_child;
-    int next_fd;
+    int next_mapid;
     struct file* file;
-    struct list files;
+    struct file **fds;          /* Open files, indexed by fd. */
+    size_t fd_cap;              /* Number of slots in FDS. */
+    struct bitmap *fd_map;      /* Slots in use in FDS. */
     int exit_status;
     bool dead;
     struct list children;
     struct list_elem child_elem;
-    struct hash pages;
+    struct spt pages;
+    struct page_arena spt_arena;
     struct list map;
+    struct list vmas;
+    uint32_t *dead_pagedir;     /* Page directory left for the reaper. */
+    struct list_elem reap_elem; /* Element in the reaper's queue. */
+    bool reaping;               /* Reaper hasn't torn us down yet? */
+    bool release;               /* Free us once the reaper is done? */
+    bool user_copy;             /* In copy_from_user/copy_to_user? */
 
     struct dir* cwd;
     /**********END OF NEW **********/
@@ -135,11 +146,7 @@ struct map{
   uint8_t *addr;
   unsigned cnt;
   unsigned mapid;
-};
-struct fd_{
-  int fd;
-  struct file *file;
-  struct list_elem elem;
+  struct vma *vma;
 };
 
 
@@ -170,6 +177,7 @@ tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
+void thread_release (struct thread *);
 void thread_yield (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
@@ -0,0 +1,248 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
+#ifdef FILESYS
+#include "devices/block.h"
+#endif
+
+/* Kernel event tracing.
+
+   printf() takes the console lock and is slow, so it changes the
+   timing of whatever it is meant to observe.  Instead, the kernel
+   can record binary events, such as thread switches, page faults,
+   and disk requests, in a ring buffer that is allocated once at
+   boot.  Recording an event only disables interrupts for long
+   enough to fill in one slot.  When the buffer is full, the
+   oldest events are overwritten.
+
+   Tracing is enabled with the -trace kernel option.  At shutdown
+   the buffer is dumped, oldest event first, after a `struct
+   trace_header', either to the serial port as lines of hex
+   prefixed by "TRACE " or as raw sectors at the start of the
+   scratch device.  utils/pintos-trace decodes either form. */
+
+/* Number of pages in the ring buffer. */
+#define TRACE_PAGES 24
+
+/* Number of events in the ring buffer.  A power of 2. */
+#define TRACE_EVENTS (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+
+/* Identifies a trace dump, and its format version. */
+#define TRACE_MAGIC "PTRC"
+#define TRACE_VERSION 1
+
+/* Precedes the events in a dump. */
+struct trace_header
+  {
+    char magic[4];              /* TRACE_MAGIC. */
+    uint16_t version;           /* TRACE_VERSION. */
+    uint16_t event_size;        /* sizeof (struct trace_event). */
+    uint32_t event_cnt;         /* Number of events that follow. */
+    uint32_t lost_cnt;          /* Number of events overwritten. */
+    uint64_t start_tsc;         /* Time-stamp counter when tracing began. */
+    uint64_t end_tsc;           /* Time-stamp counter when it ended. */
+    int64_t ticks;              /* Timer ticks in between. */
+    uint32_t timer_freq;        /* Timer ticks per second. */
+    uint32_t reserved;          /* Always 0. */
+  };
+
+/* True while events are being recorded. */
+bool trace_enabled;
+
+/* Ring buffer. */
+static struct trace_event *events;
+static uint64_t event_cnt;      /* Events ever recorded. */
+
+/* Where to dump the buffer. */
+static bool dump_to_scratch;
+
+/* When tracing began. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+/* Allocates the ring buffer and begins tracing.  DEST, which must
+   be "serial" or "scratch", says where trace_dump() will put the
+   buffer. */
+void
+trace_init (const char *dest)
+{
+  ASSERT ((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0);
+
+  if (!strcmp (dest, "scratch"))
+    dump_to_scratch = true;
+  else if (strcmp (dest, "serial"))
+    PANIC ("-trace: unknown destination `%s'", dest);
+
+  events = palloc_get_multiple (PAL_ASSERT, TRACE_PAGES);
+  start_tsc = rdtsc ();
+  start_ticks = timer_ticks ();
+  trace_enabled = true;
+}
+
+/* Returns the running thread's tid.  Unlike thread_current(),
+   works in schedule(), where the running thread is not in the
+   THREAD_RUNNING state. */
+static uint16_t
+running_tid (void)
+{
+  uint32_t *esp;
+
+  asm ("mov %%esp, %0" : "=g" (esp));
+  return ((struct thread *) pg_round_down (esp))->tid;
+}
+
+/* Records an event of the given TYPE with arguments A0, A1, and
+   A2.  Use trace() instead, which skips the call if tracing is
+   disabled. */
+void
+trace_record (enum trace_type type, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+  enum intr_level old_level;
+  struct trace_event *e;
+
+  old_level = intr_disable ();
+  e = &events[(uint32_t) event_cnt++ & (TRACE_EVENTS - 1)];
+  e->tsc = rdtsc ();
+  e->type = type;
+  e->tid = running_tid ();
+  e->arg[0] = a0;
+  e->arg[1] = a1;
+  e->arg[2] = a2;
+  intr_set_level (old_level);
+}
+
+/* Returns the first 4 characters of NAME packed into an event
+   argument, first character in the low byte. */
+uint32_t
+trace_pack_name (const char *name)
+{
+  uint32_t packed = 0;
+  int i;
+
+  for (i = 0; i < 4 && name[i] != '\0'; i++)
+    packed |= (uint32_t) (uint8_t) name[i] << (i * 8);
+  return packed;
+}
+
+/* Copies N bytes starting at offset OFS in the dump, which is H
+   followed by the buffered events oldest first, into DST. */
+static void
+read_dump (const struct trace_header *h, size_t ofs, uint8_t *dst, size_t n)
+{
+  uint32_t first = event_cnt - h->event_cnt;
+
+  for (; n > 0; n--, ofs++)
+    if (ofs < sizeof *h)
+      *dst++ = ((const uint8_t *) h)[ofs];
+    else
+      {
+        size_t idx = (ofs - sizeof *h) / sizeof (struct trace_event);
+        size_t byte = (ofs - sizeof *h) % sizeof (struct trace_event);
+        const uint8_t *e;
+
+        if (idx >= h->event_cnt)
+          *dst++ = 0;
+        else
+          {
+            e = (const uint8_t *) &events[(first + idx) & (TRACE_EVENTS - 1)];
+            *dst++ = e[byte];
+          }
+      }
+}
+
+#ifdef FILESYS
+/* Writes the dump, SIZE bytes described by H, to the start of
+   the scratch device.  Returns false if there is no scratch
+   device or it is too small. */
+static bool
+dump_scratch (const struct trace_header *h, size_t size)
+{
+  struct block *scratch = block_get_role (BLOCK_SCRATCH);
+  static uint8_t sector[BLOCK_SECTOR_SIZE];
+  size_t sector_cnt = DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+  size_t i;
+
+  if (scratch == NULL)
+    {
+      printf ("trace: no scratch device\n");
+      return false;
+    }
+  if (block_size (scratch) < sector_cnt)
+    {
+      printf ("trace: scratch device %s too small for %zu-byte trace\n",
+              block_name (scratch), size);
+      return false;
+    }
+
+  for (i = 0; i < sector_cnt; i++)
+    {
+      read_dump (h, i * BLOCK_SECTOR_SIZE, sector, BLOCK_SECTOR_SIZE);
+      block_write (scratch, i, sector);
+    }
+  printf ("trace: %"PRIu32" events written to %s\n",
+          h->event_cnt, block_name (scratch));
+  return true;
+}
+#endif
+
+/* Writes the dump, SIZE bytes described by H, to the console,
+   which includes the serial port, in hex. */
+static void
+dump_serial (const struct trace_header *h, size_t size)
+{
+  uint8_t line[32];
+  size_t ofs, i;
+
+  printf ("trace: begin\n");
+  for (ofs = 0; ofs < size; ofs += sizeof line)
+    {
+      size_t n = size - ofs < sizeof line ? size - ofs : sizeof line;
+      read_dump (h, ofs, line, n);
+      printf ("TRACE ");
+      for (i = 0; i < n; i++)
+        printf ("%02x", line[i]);
+      printf ("\n");
+    }
+  printf ("trace: end\n");
+}
+
+/* Stops tracing and dumps the ring buffer where trace_init() was
+   told to.  Does nothing if tracing was never enabled. */
+void
+trace_dump (void)
+{
+  struct trace_header h;
+  uint64_t lost;
+
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+
+  memset (&h, 0, sizeof h);
+  memcpy (h.magic, TRACE_MAGIC, sizeof h.magic);
+  h.version = TRACE_VERSION;
+  h.event_size = sizeof (struct trace_event);
+  h.event_cnt = event_cnt < TRACE_EVENTS ? event_cnt : TRACE_EVENTS;
+  lost = event_cnt - h.event_cnt;
+  h.lost_cnt = lost < UINT32_MAX ? lost : UINT32_MAX;
+  h.start_tsc = start_tsc;
+  h.end_tsc = rdtsc ();
+  h.ticks = timer_ticks () - start_ticks;
+  h.timer_freq = TIMER_FREQ;
+
+#ifdef FILESYS
+  if (dump_to_scratch
+      && dump_scratch (&h, sizeof h + h.event_cnt * sizeof *events))
+    return;
+#endif
+  dump_serial (&h, sizeof h + h.event_cnt * sizeof *events);
+}
@@ -0,0 +1,56 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel event tracing.  See trace.c. */
+
+/* Types of trace events, with the meanings of their arguments. */
+enum trace_type
+  {
+    TRACE_SCHEDULE = 1,         /* Switch to thread A0, leaving the
+                                   running thread in status A1. */
+    TRACE_PAGE_FAULT,           /* Fault on address A0 by the
+                                   instruction at A1, error code A2. */
+    TRACE_EVICT,                /* Evict user page A0 of thread A1,
+                                   to swap if A2 is nonzero. */
+    TRACE_SWAP_WRITE,           /* Write user page A0 to swap sector A1. */
+    TRACE_SWAP_READ,            /* Read user page A0 from swap sector A1. */
+    TRACE_BLOCK_READ,           /* Read A1 sectors starting at A0 from
+                                   the device named A2. */
+    TRACE_BLOCK_WRITE,          /* Write A1 sectors starting at A0 to
+                                   the device named A2. */
+    TRACE_LOCK_WAIT,            /* Waited A2 cycles for lock A0, held
+                                   by thread A1 when the wait began. */
+    TRACE_TYPE_CNT
+  };
+
+/* A trace event.  Device names are packed into an argument as up
+   to 4 characters, first character in the low byte. */
+struct trace_event
+  {
+    uint64_t tsc;               /* Time-stamp counter. */
+    uint16_t type;              /* A TRACE_* type. */
+    uint16_t tid;               /* Thread running at the time. */
+    uint32_t arg[3];            /* Arguments; see enum trace_type. */
+  };
+
+extern bool trace_enabled;
+
+void trace_init (const char *dest);
+void trace_record (enum trace_type, uint32_t, uint32_t, uint32_t);
+uint32_t trace_pack_name (const char *);
+void trace_dump (void);
+
+/* Records an event of the given TYPE with arguments A0, A1, and
+   A2, if tracing is enabled.  Costs only a test and a branch if
+   it is not. */
+static inline void
+trace (enum trace_type type, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+  if (trace_enabled)
+    trace_record (type, a0, a1, a2);
+}
+
+#endif /* threads/trace.h */
@@ -1,14 +1,17 @@
 #include "userprog/exception.h"
+#include <advice.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "threads/palloc.h"
 #include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/vma.h"
 #include "threads/pte.h"
 
 extern struct swap swap;
@@ -150,6 +153,9 @@ page_fault (struct intr_frame *f)
   asm ("movl %%cr2, %0" : "=r" (fault_addr));
   //printf("+++++++++++ TID: %d --------PAGE FAULT AT %x\n",thread_current()->tid, fault_addr);
  
+  trace (TRACE_PAGE_FAULT, (uint32_t) fault_addr, (uint32_t) f->eip,
+         f->error_code);
+
   /* Turn interrupts back on (they were only off so that we could
      be assured of reading CR2 before it changed). */
   intr_enable ();
@@ -166,34 +172,32 @@ page_fault (struct intr_frame *f)
   uint8_t *upage = (uint32_t) fault_addr & ~PGMASK;
   
   struct page *p = page_lookup(&thread_current()->pages, upage);
+  struct vma *v;
+  if(p == NULL && (v = vma_find(&thread_current()->vmas, upage)) != NULL)
+    {
+      p = vma_get_page(v, upage);
+      if(p == NULL)
+	kill(f);
+    }
   if((p != NULL) && (!write || p->writable))
     {
-      //printf("Get page\n");
-      /* Get a page of memory. */
-      void *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-      if (!kpage)
+      /* Load this page and add it to the process's address
+	 space. */
+      if(!page_load(p))
 	kill(f);
-      p->kpage = (uint8_t*) kpage;
-      /* Load this page. */
-      if(p->swap)
-	swap_read(&swap, p);
-      else if(p->file != NULL)
+      if(p->advice == ADV_SEQUENTIAL && p->file != NULL
+	 && (v = vma_find(&thread_current()->vmas, upage)) != NULL)
 	{
-	  file_seek(p->file, p->ofs);
-	  if (file_read (p->file, kpage, p->read_bytes) != (int) p->read_bytes)
-	    {
-	      palloc_free_page (kpage);
-	      kill(f); 
-	    }
-	  memset (kpage + p->read_bytes, 0, p->zero_bytes);
-	}
-      else
-	memset (kpage + p->read_bytes, 0, p->zero_bytes);
-      /* Add the page to the process's address space. */
-      if (!pagedir_set_page(thread_current()->pagedir, (void*)p->upage, kpage,p->writable)) 
-	{
-	  palloc_free_page (kpage);
-	  kill(f); 
+	  /* Pin the page we faulted on while reading ahead.  It
+	     hasn't been accessed yet and, being sequential, gets no
+	     second chance, so it would be the first to go. */
+	  lock_acquire(&swap.lock);
+	  p->pin_cnt++;
+	  lock_release(&swap.lock);
+	  vma_read_ahead(v, upage);
+	  lock_acquire(&swap.lock);
+	  p->pin_cnt--;
+	  lock_release(&swap.lock);
 	}
     }
   else if(((unsigned)(f->esp - fault_addr) < PGSIZE) || (PHYS_BASE > fault_addr && fault_addr > stack_end))
@@ -208,16 +212,24 @@ page_fault (struct intr_frame *f)
 	}
       struct thread *t = thread_current();
 
-      struct page *p = calloc(sizeof(struct page), 1);
+      struct page *p = page_create();
       p->upage = upage;
       p->kpage = kpage;
       p->zero_bytes = PGSIZE;
       p->writable = true;
-      hash_insert(&t->pages, &p->hash_elem);
+      spt_insert(&t->pages, p);
 
       if(fault_addr < stack_end)
 	stack_end = fault_addr;     
     }
+  else if(!user && thread_current()->user_copy)
+    {
+      /* A bad user address in copy_from_user() or copy_to_user().
+         Resume at the address it left in EAX, telling it the copy
+         failed. */
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0;
+    }
   else
     {
       //printf("--------------------- Exception exit %x---------------\n", fault_addr);//, p->upage);
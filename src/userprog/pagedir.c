@@ -1,6 +1,7 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
 #include "threads/pte.h"
@@ -11,11 +12,15 @@
 
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void load_pd (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 extern struct hash frames;
 extern struct swap swap;
 
+/* Number of CR3 loads pagedir_activate() did and skipped. */
+static long long cr3_load_cnt, cr3_skip_cnt;
+
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
@@ -29,31 +34,101 @@ pagedir_create (void)
   return pd;
 }
 
+/* Number of pages pagedir_destroy() frees at a time. */
+#define FREE_BATCH 64
+
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.
+
+   Frames are unmapped and dropped from the frame table under
+   swap.lock, so that frame_evict() can't pick one of them at
+   the same time, but the lock is only held for FREE_BATCH
+   mapped pages at a stretch.  The pages themselves, and the
+   page tables, are then returned to the page allocator in
+   batches. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
+  void *batch[FREE_BATCH];
+  size_t cnt = 0;
   uint32_t *pde;
 
   if (pd == NULL)
     return;
 
   ASSERT (pd != init_page_dir);
+
+  /* Kernel threads run on whatever page directory was active
+     before them, so make sure that isn't this one. */
+  if (active_pd () == pd)
+    pagedir_activate (NULL);
+
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
-        palloc_free_page (pt);
+        uint32_t *pte = pt;
+
+        while (pte < pt + PGSIZE / sizeof *pte)
+          {
+            lock_acquire (&swap.lock);
+            for (; pte < pt + PGSIZE / sizeof *pte && cnt < FREE_BATCH; pte++)
+              if (*pte & PTE_P) 
+                {
+                  void *kpage = pte_get_page (*pte);
+                  frame_remove (&frames, kpage);
+                  *pte = 0;
+                  batch[cnt++] = kpage;
+                }
+            lock_release (&swap.lock);
+
+            if (cnt == FREE_BATCH)
+              {
+                palloc_free_batch (batch, cnt);
+                cnt = 0;
+              }
+          }
+        batch[cnt++] = pt;
       }
+  palloc_free_batch (batch, cnt);
   palloc_free_page (pd);
 }
 
+/* Removes the frame table entries of all the pages mapped in PD,
+   leaving the pages themselves mapped and allocated, so that
+   frame_evict() stops considering them.  For a dead process,
+   whose pages nobody will read again but which the reaper only
+   frees later.  As in pagedir_destroy(), swap.lock is held for
+   FREE_BATCH mapped pages at a stretch. */
+void
+pagedir_drop_frames (uint32_t *pd) 
+{
+  uint32_t *pde;
+
+  ASSERT (pd != init_page_dir);
+
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+    if (*pde & PTE_P) 
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        uint32_t *pte = pt;
+
+        while (pte < pt + PGSIZE / sizeof *pte)
+          {
+            size_t cnt = 0;
+
+            lock_acquire (&swap.lock);
+            for (; pte < pt + PGSIZE / sizeof *pte && cnt < FREE_BATCH; pte++)
+              if (*pte & PTE_P) 
+                {
+                  frame_remove (&frames, pte_get_page (*pte));
+                  cnt++;
+                }
+            lock_release (&swap.lock);
+          }
+      }
+}
+
 /* Returns the address of the page table entry for virtual
    address VADDR in page directory PD.
    If PD does not have a page table for VADDR, behavior depends
@@ -117,12 +192,12 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
       ASSERT ((*pte & PTE_P) == 0);
       *pte = pte_create_user (kpage, writable);
       // change kernel pagedir also
-      struct frame *f = calloc(sizeof(struct frame), 1);
+      struct frame *f = frame_create();
       f->kpage = kpage;
       lock_acquire(&swap.lock);
       hash_insert(&frames, &f->hash_elem);
       lock_release(&swap.lock);
-      f->hash = &thread_current()->pages;
+      f->spt = &thread_current()->pages;
       f->pd = pd;
       f->upage = upage;
       f->tid = thread_current()->tid;
@@ -165,7 +240,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
@@ -193,7 +268,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -222,19 +297,42 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
-/* Loads page directory PD into the CPU's page directory base
-   register. */
+/* Makes page directory PD, or the kernel-only page directory if
+   PD is null, the active one.  Does nothing if PD is already
+   active: reloading CR3 would only throw away TLB entries that
+   are still good. */
 void
 pagedir_activate (uint32_t *pd) 
 {
   if (pd == NULL)
     pd = init_page_dir;
+  if (pd == active_pd ())
+    {
+      cr3_skip_cnt++;
+      return;
+    }
+  cr3_load_cnt++;
+  load_pd (pd);
+}
 
+/* Prints page directory statistics. */
+void
+pagedir_print_stats (void) 
+{
+  printf ("Paging: %lld CR3 loads, %lld skipped\n",
+          cr3_load_cnt, cr3_skip_cnt);
+}
+
+/* Loads page directory PD into the CPU's page directory base
+   register, flushing all non-global TLB entries. */
+static void
+load_pd (uint32_t *pd) 
+{
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -256,21 +354,70 @@ active_pd (void)
   return ptov (pd);
 }
 
-/* Seom page table changes can cause the CPU's translation
+/* Starts a batch of PTE updates by the running thread.  Until
+   the matching pagedir_batch_end(), the TLB entries that the
+   updates make stale are only recorded in B, not flushed, so the
+   running thread must not touch the affected user pages before
+   then.  Other threads are safe: switching to another address
+   space reloads CR3.  Batches may nest. */
+void
+pagedir_batch_begin (struct tlb_batch *b) 
+{
+  struct thread *t = thread_current ();
+
+  b->prev = t->tlb_batch;
+  b->cnt = 0;
+  t->tlb_batch = b;
+}
+
+/* Ends batch B, which must be the running thread's innermost
+   batch, and flushes the TLB entries it recorded: page by page if
+   there are few of them, otherwise all at once by reloading
+   CR3. */
+void
+pagedir_batch_end (struct tlb_batch *b) 
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  ASSERT (t->tlb_batch == b);
+  t->tlb_batch = b->prev;
+  if (b->cnt > TLB_BATCH_MAX)
+    load_pd (active_pd ());
+  else
+    for (i = 0; i < b->cnt; i++)
+      asm volatile ("invlpg (%0)" : : "r" (b->pages[i]) : "memory");
+}
+
+/* Some page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
-   table.  When this happens, we have to "invalidate" the TLB by
-   re-activating it.
+   table.  When this happens, we have to "invalidate" the stale
+   entry.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates the TLB entry for VPAGE if PD is the
+   active page directory.  (If PD is not active then its entries
+   are not in the TLB, so there is no need to invalidate
+   anything.)  INVLPG drops just that one entry, unlike reloading
+   CR3, which drops every non-global entry.  Inside a batch, the
+   flush is deferred to pagedir_batch_end(). */
 static void
-invalidate_pagedir (uint32_t *pd) 
+invalidate_page (uint32_t *pd, const void *vpage) 
 {
-  if (active_pd () == pd) 
+  struct tlb_batch *b;
+
+  if (active_pd () != pd)
+    return;
+
+  b = thread_current ()->tlb_batch;
+  if (b != NULL)
+    {
+      if (b->cnt < TLB_BATCH_MAX)
+        b->pages[b->cnt] = vpage;
+      b->cnt++;
+    }
+  else
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
-    } 
+      /* See [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+      asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+    }
 }
@@ -2,10 +2,25 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Maximum number of pages a TLB flush batch invalidates one by
+   one.  A batch that touches more pages reloads CR3 instead. */
+#define TLB_BATCH_MAX 32
+
+/* Defers TLB invalidations for the running thread's PTE updates
+   until pagedir_batch_end().  See pagedir_batch_begin(). */
+struct tlb_batch
+  {
+    struct tlb_batch *prev;             /* Enclosing batch, if any. */
+    size_t cnt;                         /* Number of pages to flush. */
+    const void *pages[TLB_BATCH_MAX];   /* First TLB_BATCH_MAX pages. */
+  };
+
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
+void pagedir_drop_frames (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
@@ -14,6 +29,9 @@ void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
+void pagedir_print_stats (void);
+void pagedir_batch_begin (struct tlb_batch *);
+void pagedir_batch_end (struct tlb_batch *);
 uint32_t *lookup_page (uint32_t *pd, const void *vaddr, bool create);
 
 #endif /* userprog/pagedir.h */
@@ -9,6 +9,7 @@
 #include "vm/page.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -20,9 +21,11 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "lib/string.h"
 #include <stdlib.h>
 #include "vm/swap.h"
+#include "vm/vma.h"
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
@@ -115,7 +118,7 @@ process_wait (tid_t child_tid UNUSED)
 	thread_yield();
       int exit = t->exit_status;
       ASSERT(t->status == THREAD_ZOMBIE);
-      palloc_free_page(t); // reap the child
+      thread_release(t); // reap the child
       //printf("Reaped the Child:%d\n", child_tid);
       return exit;
     }
@@ -123,6 +126,76 @@ process_wait (tid_t child_tid UNUSED)
   return -1;
 }
 
+/* Dead processes waiting for the reaper. */
+static struct list reap_list;
+static struct lock reap_lock;
+static struct condition reap_cond;
+
+static void reaper (void *);
+static void process_teardown (struct thread *);
+
+/* Starts the reaper thread, which frees the address spaces of
+   exited processes in the background so that exit, and the
+   parent's wait, don't have to wait for it.  The scheduler
+   ignores priorities, so PRI_MIN is only advisory; the reaper
+   yields between steps instead so that it doesn't hog the CPU
+   for a whole time slice per process. */
+void
+process_init (void)
+{
+  list_init (&reap_list);
+  lock_init (&reap_lock);
+  lock_set_name (&reap_lock, "reap");
+  cond_init (&reap_cond);
+  thread_create ("reaper", PRI_MIN, reaper, NULL);
+}
+
+/* Reaper thread.  Tears down the address spaces queued by
+   process_exit(), one at a time, yielding after each. */
+static void
+reaper (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct thread *t;
+
+      lock_acquire (&reap_lock);
+      while (list_empty (&reap_list))
+        cond_wait (&reap_cond, &reap_lock);
+      t = list_entry (list_pop_front (&reap_list), struct thread, reap_elem);
+      lock_release (&reap_lock);
+
+      process_teardown (t);
+      thread_yield ();
+    }
+}
+
+/* Frees T's user pages, swap slots, and page tables, yielding
+   between each.  If T has already been reaped by its parent,
+   frees T as well. */
+static void
+process_teardown (struct thread *t)
+{
+  enum intr_level old_level;
+  bool release;
+
+  pagedir_destroy (t->dead_pagedir);
+  t->dead_pagedir = NULL;
+  thread_yield ();
+  swap_remove(&swap, &t->pages);
+  thread_yield ();
+  spt_destroy(&t->pages);
+  vma_destroy_all(&t->vmas);
+  page_arena_destroy(&t->spt_arena);
+
+  old_level = intr_disable ();
+  t->reaping = false;
+  release = t->release;
+  intr_set_level (old_level);
+  if (release)
+    palloc_free_page (t);
+}
+
 /* Free the current process's resources. */
 void
 process_exit (void)
@@ -134,19 +207,8 @@ process_exit (void)
   for( e = list_begin(&t->map); e != list_end(&t->map);)
     {
       struct map *m = list_entry(e, struct map, list_elem);
-      for(int i = 0; i < m->cnt; i++)
-	{
-	  struct page *p = page_lookup(&t->pages, m->addr + i * PGSIZE);
-	  if(pagedir_is_dirty(t->pagedir, p->upage))
-	    file_write_at(p->file, p->upage, PGSIZE, p->ofs);
-	  pagedir_clear_page(t->pagedir, p->upage);
-	  palloc_free_page(p->kpage);
-	  hash_delete(&t->pages, &p->hash_elem);
-	  free(p->file);
-	  free(p);
-	}
-      e = list_remove(&m->list_elem);
-      free(m);
+      e = list_next(e);
+      munmap(t, m);
     }
   //printf("-------------------in child ------------------------\n");
   	
@@ -167,12 +229,21 @@ process_exit (void)
          that's been freed (and cleared). */
       t->pagedir = NULL;
       pagedir_activate (NULL);
-      lock_acquire(&swap.lock);
-      pagedir_destroy (pd);
-      lock_release(&swap.lock);
+
+      /* Take our frames out of the frame table now, so that
+         frame_evict() doesn't waste swap writes on them, and
+         leave the rest to the reaper.  Our struct thread stays
+         allocated until it is done; see thread_release(). */
+      pagedir_drop_frames (pd);
+      t->dead_pagedir = pd;
+      t->reaping = true;
+      lock_acquire (&reap_lock);
+      list_push_back (&reap_list, &t->reap_elem);
+      cond_signal (&reap_cond, &reap_lock);
+      lock_release (&reap_lock);
     }
-  swap_remove(&swap, &t->pages);
-  hash_destroy(&t->pages, page_free);
+  else
+    process_teardown (t);
   //printf("+++++++++++++++++++++++++++++++++++++++\n");
 }
 
@@ -184,8 +255,13 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables.  A kernel thread never
+     touches user memory, so it keeps running on the previous
+     thread's page directory, whose kernel mappings are the same
+     as everyone's, and we avoid the CR3 load and the TLB misses
+     that follow it. */
+  if (t->pagedir != NULL)
+    pagedir_activate (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -280,7 +356,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
   int i;
   
   /****************NEW LINES ***************/
-  hash_init(&t->pages, page_hash, page_less, NULL);
  
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
@@ -543,38 +618,9 @@ load_segment_modified (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  //printf("Loading segment from executable\n");
-  file_seek (file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0) 
-    {
-      //printf("one full page read at upage %x\n", upage);
-      //   Calculate how to fill this page.
-      //   We will read PAGE_READ_BYTES bytes from FILE
-      //   and zero the final PAGE_ZERO_BYTES bytes.
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      struct page *p = calloc(sizeof(struct page), 1);
-      if(page_read_bytes == 0)
-	p->file = NULL;
-      else
-	p->file = file;
-      p->ofs = ofs;
-      p->upage = upage;
-      p->read_bytes = page_read_bytes;
-      p->zero_bytes = page_zero_bytes;
-      p->writable = writable;
-      p->kpage = NULL;
-      p->swap = false;
-      hash_insert(&thread_current()->pages, &p->hash_elem);
-      
-      // Advance. 
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
-      ofs += page_read_bytes;
-    }
-  return true;
+  /* Pages are read in on first touch; see page_fault(). */
+  return vma_create(&thread_current()->vmas, upage, read_bytes + zero_bytes,
+		    file, ofs, read_bytes, writable) != NULL;
 }
 
 
@@ -587,14 +633,14 @@ setup_stack (void **esp)
   bool success = false;
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
 
-  struct page *p = calloc(sizeof(struct page), 1);
+  struct page *p = page_create();
   p->swap = false;
   p->upage = ((uint8_t*) PHYS_BASE) - PGSIZE;
   p->kpage = kpage;
   p->file = NULL;
   p->zero_bytes = PGSIZE;
   p->writable = true;
-  hash_insert(&thread_current()->pages, &p->hash_elem);
+  spt_insert(&thread_current()->pages, p);
   
   if (kpage != NULL) 
     {
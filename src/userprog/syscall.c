@@ -1,6 +1,13 @@
 #include "userprog/syscall.h"
+#include <advice.h>
+#include <bitmap.h>
+#include <blkstat.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <uio.h>
+#include "devices/block.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
@@ -9,20 +16,27 @@
 #include "filesys/file.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/init.h"
 #include "threads/palloc.h"
+#include "vm/frame.h"
 #include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/vma.h"
 
 
 static void syscall_handler (struct intr_frame *);
 extern uint8_t* stack_end;
 extern struct swap swap;
+extern struct hash frames;
 
+/* Cache for memory mappings. */
+struct kmem_cache *map_cache;
 
 void
 syscall_init (void) 
 {
+  map_cache = kmem_cache_create ("map", sizeof (struct map), NULL);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -32,7 +46,8 @@ bool valid_byte(void *p){
     return true;
   else if(p >= PHYS_BASE || p == NULL)
     return false;
-  else if(!pagedir_get_page(t->pagedir,p) && !page_lookup(&t->pages, p))
+  else if(!pagedir_get_page(t->pagedir,p) && !page_lookup(&t->pages, p)
+	  && !vma_find(&t->vmas, p))
     return false;
   else
     return true;
@@ -46,102 +61,247 @@ void exit(void){
 }
   
 
+/* User memory is checked a page at a time: every byte of a page
+   is valid if any is, so only the first byte we touch in each
+   page goes through valid_byte(). */
+
 void check_string(char *str){
-  if(!valid_byte(str))
-    exit();
-  for(int i = 0; i < strlen(str) + 1; i++)
-    if(!valid_byte(str + i)){
-      exit();
+  for(;;)
+    {
+      char *page_end = (char *) pg_round_down(str) + PGSIZE;
+      if(!valid_byte(str))
+	exit();
+      for(; str < page_end; str++)
+	if(*str == '\0')
+	  return;
     }
 }
 
 void check_buffer(void *buffer, size_t size){
-  for(int i = 0; i < size; i++)
-    if(!valid_byte(buffer + i))
-      exit();
+  uint8_t *p = buffer;
+  uint8_t *last = p + size - 1;
+  if(size == 0)
+    return;
+  if(last < p)
+    exit();
+  for(;;)
+    {
+      if(!valid_byte(p))
+	exit();
+      p = (uint8_t *) pg_round_down(p) + PGSIZE;
+      if(p > last || p == NULL)
+	break;
+    }
+}
+
+/* Copies N bytes from SRC to DST, either of which may be in user
+   memory, with a fault-tolerant `rep movsb'.  If the copy faults
+   on user memory that page_fault() can't bring in, page_fault()
+   resumes us at label 1 with EAX set to 0 (see its handling of
+   USER_COPY), and we return false. */
+static bool user_copy(void *dst, const void *src, size_t n)
+{
+  struct thread *t = thread_current();
+  int ok;
+  t->user_copy = true;
+  asm volatile ("movl $1f, %%eax; rep movsb; movl $1, %%eax; 1:"
+		: "=&a" (ok), "+S" (src), "+D" (dst), "+c" (n)
+		: : "memory");
+  t->user_copy = false;
+  return ok != 0;
 }
 
-void check_ptr(void *ptr){
-  check_buffer(ptr, 4);
+/* Returns true if the N bytes at UADDR lie below PHYS_BASE. */
+static bool user_range_ok(const void *uaddr, size_t n)
+{
+  const uint8_t *p = uaddr;
+  return p + n >= p && (void *) (p + n) <= PHYS_BASE;
+}
+
+/* Copies N bytes from user address USRC to kernel address DST.
+   Faults in pages as needed.  Returns false if any of USRC is
+   not valid user memory, in which case DST is partly written. */
+bool copy_from_user(void *dst, const void *usrc, size_t n){
+  return user_range_ok(usrc, n) && user_copy(dst, usrc, n);
+}
+
+/* Copies N bytes from kernel address SRC to user address UDST.
+   Faults in pages as needed.  Returns false if any of UDST is
+   not valid, writable user memory, in which case UDST is partly
+   written. */
+bool copy_to_user(void *udst, const void *src, size_t n){
+  return user_range_ok(udst, n) && user_copy(udst, src, n);
+}
+
+/* Returns system call argument N, the Nth word of the user stack
+   at P, copied in with copy_from_user(), so that the handler
+   never dereferences the user stack itself.  Argument 0 is the
+   system call number.  Exits the process if the word isn't
+   readable user memory. */
+static uint32_t get_user_arg(const int *p, int n){
+  uint32_t word;
+  if(!copy_from_user(&word, p + n, sizeof word))
+    exit();
+  return word;
 }
     
-struct fd_ *search_fd(struct thread *t, int fd){
-    struct list_elem *e;
-    struct fd_ *file_d = NULL;
-    for( e = list_begin(&t->files); e != list_end(&t->files); e = list_next(e)){
-      file_d = list_entry(e, struct fd_, elem);
-      if(file_d->fd == fd)
-	break;
+/* Each process keeps its open files in an array indexed by file
+   descriptor, so a lookup is a bounds check and a load.  A bitmap
+   of used slots finds the lowest free descriptor for open.  Both
+   start out empty and double in size as needed.  Descriptors 0
+   and 1 are reserved for the console. */
+
+/* Initial number of file descriptor slots. */
+#define FD_TABLE_MIN 16
+
+/* Doubles the size of T's file descriptor table.  Returns false
+   if out of memory. */
+static bool fd_table_grow(struct thread *t)
+{
+  size_t cap = t->fd_cap > 0 ? t->fd_cap * 2 : FD_TABLE_MIN;
+  struct file **fds;
+  struct bitmap *map;
+
+  fds = realloc(t->fds, cap * sizeof *fds);
+  if(fds == NULL)
+    return false;
+  t->fds = fds;
+  map = bitmap_create(cap);
+  if(map == NULL)
+    return false;
+
+  memset(fds + t->fd_cap, 0, (cap - t->fd_cap) * sizeof *fds);
+  if(t->fd_map != NULL)
+    {
+      for(size_t i = 0; i < t->fd_cap; i++)
+	bitmap_set(map, i, bitmap_test(t->fd_map, i));
+      bitmap_destroy(t->fd_map);
     }
-    if(file_d == NULL || file_d->fd != fd)
-      return NULL;
-    else
-      return file_d;
+  else
+    bitmap_set_multiple(map, 0, 2, true);
+  t->fd_map = map;
+  t->fd_cap = cap;
+  return true;
 }
 
-void pin_page(uint32_t start, unsigned size)
+/* Gives FILE the lowest free descriptor in T and returns it, or
+   -1 if out of memory. */
+int alloc_fd(struct thread *t, struct file *file)
 {
-  uint32_t end = start + size;
-  int count = (end / PGSIZE) - (start / PGSIZE) + 1;
-  struct page *p;
-  struct thread *t = thread_current();
-  for(int i = 0; i < count; i++)
+  size_t fd = BITMAP_ERROR;
+  if(t->fd_map != NULL)
+    fd = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
+  if(fd == BITMAP_ERROR)
     {
-      p = page_lookup(&t->pages, start + i * PGSIZE);
-      if(!p)
-	{
-	  p = calloc(sizeof(struct page), 1);
-	  p->upage = (start + i * PGSIZE) & !PGMASK;
-	  p->zero_bytes = PGSIZE;
-	  p->writable = true;
-	  hash_insert(&t->pages, &p->hash_elem);
-	  if(p->upage < stack_end)
-	    stack_end = p->upage;     
-	}
-      p->lock = true;
+      if(!fd_table_grow(t))
+	return -1;
+      fd = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
+    }
+  t->fds[fd] = file;
+  return fd;
+}
+
+/* Returns the file open as FD in T, or NULL. */
+struct file *search_fd(struct thread *t, int fd)
+{
+  if(fd < 0 || (size_t) fd >= t->fd_cap)
+    return NULL;
+  return t->fds[fd];
+}
 
-      if(!pagedir_get_page(t->pagedir, p->upage))
+/* Closes FD in T, if open. */
+void close_fd(struct thread *t, int fd)
+{
+  struct file *file = search_fd(t, fd);
+  if(file != NULL)
+    {
+      file_close(file);
+      t->fds[fd] = NULL;
+      bitmap_reset(t->fd_map, fd);
+    }
+}
+
+/* Closes all of T's files and frees its descriptor table. */
+void close_all_fds(struct thread *t)
+{
+  for(size_t fd = 0; fd < t->fd_cap; fd++)
+    if(t->fds[fd] != NULL)
+      file_close(t->fds[fd]);
+  free(t->fds);
+  bitmap_destroy(t->fd_map);
+  t->fds = NULL;
+  t->fd_map = NULL;
+  t->fd_cap = 0;
+}
+
+/* Writes back and releases the pages of mapping M of thread T
+   that have been faulted in, then removes the mapping.  madvise()
+   may have split the mapping's region; the pieces follow M->vma
+   in T's list and share its file.  Each frame leaves the frame
+   table under swap.lock before anything else, so frame_evict()
+   can't pick it while we work on it.  Frames go back to the user
+   pool only after the TLB batch that unmapped them is flushed,
+   as in pagedir_destroy(). */
+void munmap(struct thread *t, struct map *m)
+{
+  struct file *file = m->vma->file;
+  struct list_elem *e = &m->vma->elem;
+  struct tlb_batch batch;
+  void *kpages[TLB_BATCH_MAX];
+  size_t cnt = 0;
+  pagedir_batch_begin(&batch);
+  while(e != list_end(&t->vmas)
+	&& list_entry(e, struct vma, elem)->file == file)
+    {
+      struct vma *v = list_entry(e, struct vma, elem);
+      e = list_next(e);
+      for(uint8_t *upage = v->start; upage < v->end; upage += PGSIZE)
 	{
-	  void *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-	  
-	  p->kpage = (uint8_t*) kpage;
-	  if(p->swap)
-	    swap_read(&swap, p);
-	  else if(p->file != NULL)
+	  struct page *p = page_lookup(&t->pages, upage);
+	  uint8_t *kpage;
+	  if(p == NULL)
+	    continue;
+	  lock_acquire(&swap.lock);
+	  kpage = pagedir_get_page(t->pagedir, upage);
+	  if(kpage != NULL)
+	    frame_remove(&frames, kpage);
+	  lock_release(&swap.lock);
+	  if(kpage != NULL)
 	    {
-	      file_seek(p->file, p->ofs);
-	      if (file_read (p->file, kpage, p->read_bytes) != (int) p->read_bytes)
+	      if(p->file != NULL && pagedir_is_dirty(t->pagedir, upage))
+		file_write_at(p->file, upage, p->read_bytes, p->ofs);
+	      pagedir_clear_page(t->pagedir, upage);
+	      kpages[cnt++] = kpage;
+	      if(cnt == TLB_BATCH_MAX)
 		{
-		  palloc_free_page (kpage);
+		  pagedir_batch_end(&batch);
+		  palloc_free_batch(kpages, cnt);
+		  cnt = 0;
+		  pagedir_batch_begin(&batch);
 		}
-	      memset (kpage + p->read_bytes, 0, p->zero_bytes);
 	    }
-	  else
-	    memset (kpage + p->read_bytes, 0, p->zero_bytes);
-	  pagedir_set_page(t->pagedir, (void*)p->upage, kpage,p->writable);
+	  else if(p->swap)
+	    swap_free(&swap, p);
+	  spt_remove(&t->pages, p);
+	  page_destroy(p);
 	}
+      vma_destroy(v);
     }
+  pagedir_batch_end(&batch);
+  palloc_free_batch(kpages, cnt);
+  file_close(file);
+  list_remove(&m->list_elem);
+  kmem_cache_free(map_cache, m);
 }
 
-void unpin_page(uint32_t start, unsigned size)
-{
-  uint32_t end = start + size;
-  int count = (end / PGSIZE) - (start / PGSIZE) + 1;
-  struct page *p;
-  for(int i = 0; i < count; i++)
-    {
-      p = page_lookup(&thread_current()->pages, start + i * PGSIZE);
-      p->lock = false;
-    }
-}
 
 
 
 static bool
 isdir(struct thread* t, int fd) {
-  struct fd_* file_d = search_fd(t, fd);
-  if(file_d) {
-    return file_d->file->inode->data.is_dir;
+  struct file *fd_file = search_fd(t, fd);
+  if(fd_file) {
+    return fd_file->inode->data.is_dir;
   }
   else{
     return false;
@@ -151,9 +311,9 @@ isdir(struct thread* t, int fd) {
 
 static int
 inumber(struct thread* t, int fd){
-  struct fd_* file_d = search_fd(t, fd);
-  if(file_d) {
-    return file_d->file->inode->sector;
+  struct file *fd_file = search_fd(t, fd);
+  if(fd_file) {
+    return fd_file->inode->sector;
   }
   else{
     return 0;
@@ -163,11 +323,11 @@ inumber(struct thread* t, int fd){
 
 static bool
 readdir(struct thread *t, int fd, char *name) {
-  struct fd_* file_d = search_fd(t, fd);
-  if (file_d && isdir(t, fd)) {
+  struct file *fd_file = search_fd(t, fd);
+  if (fd_file && isdir(t, fd)) {
     struct dir_entry e;
     int bytes_read;
-    while(bytes_read = file_read(file_d->file, &e, sizeof e)) {
+    while(bytes_read = file_read(fd_file, &e, sizeof e)) {
       if (bytes_read!=sizeof e) {
 	return false;
       }
@@ -185,13 +345,314 @@ readdir(struct thread *t, int fd, char *name) {
 
 
 
+/* Reads SIZE bytes from FD in T into user BUFFER.  Reads at
+   file offset OFS if it is nonnegative, otherwise at the file's
+   current position, which is then advanced.  Returns the number
+   of bytes read, or -1 if FD is not open or doesn't support
+   positional reads.  Kills the process if BUFFER is bad. */
+static int
+read_fd(struct thread *t, int fd, void *buffer, unsigned size, off_t ofs)
+{
+  struct page_pin pin;
+  int result;
+
+  check_buffer(buffer, size);
+  if(!page_pin(&pin, buffer, size))
+    exit();
+  if(fd == 0)
+    result = ofs < 0 ? input_getc() : -1;
+  else{
+    struct file *fd_file = search_fd(t, fd);
+    if(fd_file == NULL)
+      result = -1;
+    else if(ofs < 0)
+      result = file_read(fd_file, buffer, size);
+    else
+      result = file_read_at(fd_file, buffer, size, ofs);
+  }
+  page_unpin(&pin);
+  return result;
+}
+
+/* Writes SIZE bytes from user BUFFER to FD in T, at OFS as in
+   read_fd().  Returns the number of bytes written, or -1 if FD
+   is not open, is a directory, or doesn't support positional
+   writes.  Kills the process if BUFFER is bad. */
+static int
+write_fd(struct thread *t, int fd, const void *buffer, unsigned size, off_t ofs)
+{
+  struct page_pin pin;
+  int result;
+
+  if(isdir(t, fd))
+    return -1;
+  check_buffer(buffer, size);
+  if(!page_pin(&pin, buffer, size))
+    exit();
+  if(fd == 0)
+    result = -1;//writing to stdin
+  else if(fd == 1)
+    {
+      if(ofs < 0){
+	putbuf(buffer, size);
+	result = size;
+      }
+      else
+	result = -1;
+    }
+  else {
+    struct file *fd_file = search_fd(t, fd);
+    if(fd_file == NULL)
+      result = -1;
+    else if(ofs < 0)
+      result = file_write(fd_file, buffer, size);
+    else
+      result = file_write_at(fd_file, buffer, size, ofs);
+  }
+  page_unpin(&pin);
+  return result;
+}
+
+/* Reads into, or if WRITE is true writes from, the IOVCNT
+   buffers described by the user array IOV, in order, at FD's
+   current position.  Stops early at a short transfer.  Returns
+   the total number of bytes transferred, or -1 if IOVCNT is out
+   of range or nothing could be transferred because of an error. */
+static int
+rw_vector(struct thread *t, int fd, const struct iovec *iov, int iovcnt,
+	  bool write)
+{
+  int total = 0;
+
+  if(iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  for(int i = 0; i < iovcnt; i++)
+    {
+      struct iovec v;
+      int cnt;
+
+      if(!copy_from_user(&v, iov + i, sizeof v))
+	exit();
+      cnt = write ? write_fd(t, fd, v.iov_base, v.iov_len, -1)
+	: read_fd(t, fd, v.iov_base, v.iov_len, -1);
+      if(cnt < 0)
+	return total > 0 ? total : -1;
+      total += cnt;
+      if((size_t) cnt < v.iov_len)
+	break;
+    }
+  return total;
+}
+
+/* Copies up to SIZE bytes from FD_IN to FD_OUT in T, starting
+   at each file's current position and advancing both, without
+   passing the data through user memory.  Data moves a page at a
+   time, with the first chunk trimmed so that later reads start on
+   a sector boundary and go straight from disk into the buffer.
+   Returns the number of bytes copied, which is less than SIZE at
+   end of file or if a write comes up short, or -1 if either fd is
+   not an open regular file or the two ranges overlap in one file. */
+static int
+copy_file_range(struct thread *t, int fd_in, int fd_out, unsigned size)
+{
+  struct file *in = search_fd(t, fd_in);
+  struct file *out = search_fd(t, fd_out);
+  struct inode *in_inode, *out_inode;
+  off_t in_pos, out_pos;
+  uint8_t *buffer;
+  int total = 0;
+
+  if(in == NULL || out == NULL || isdir(t, fd_in) || isdir(t, fd_out))
+    return -1;
+  in_inode = file_get_inode(in);
+  out_inode = file_get_inode(out);
+  in_pos = file_tell(in);
+  out_pos = file_tell(out);
+  if(in_pos < 0 || out_pos < 0)
+    return -1;
+
+  /* Copy no further than the current end of FD_IN.  This also
+     keeps SIZE below INT_MAX, so TOTAL can't overflow and the
+     unsigned range ends below can't wrap. */
+  if(in_pos >= inode_length(in_inode))
+    size = 0;
+  else if(size > (unsigned) (inode_length(in_inode) - in_pos))
+    size = inode_length(in_inode) - in_pos;
+  if(in_inode == out_inode
+     && (unsigned) in_pos < (unsigned) out_pos + size
+     && (unsigned) out_pos < (unsigned) in_pos + size)
+    return -1;
+
+  buffer = palloc_get_page(0);
+  if(buffer == NULL)
+    return -1;
+  while(size > 0)
+    {
+      size_t chunk = PGSIZE - in_pos % BLOCK_SECTOR_SIZE;
+      off_t read, written;
+
+      if(chunk > size)
+	chunk = size;
+      read = inode_read_at(in_inode, buffer, chunk, in_pos);
+      if(read <= 0)
+	break;
+      written = inode_write_at(out_inode, buffer, read, out_pos);
+      if(written > 0){
+	in_pos += written;
+	out_pos += written;
+	total += written;
+	size -= written;
+      }
+      if(written < read)
+	break;
+    }
+  palloc_free_page(buffer);
+
+  file_seek(in, in_pos);
+  file_seek(out, out_pos);
+  return total;
+}
+
+/* Applies ADVICE to the PAGE_CNT pages starting at UPAGE in T.
+   ADV_NORMAL, ADV_SEQUENTIAL and ADV_RANDOM are recorded in the
+   descriptors of pages that already have one, for frame_evict()
+   and the page fault handler to act on; pages yet to be touched
+   take their advice from their region or file instead.
+   ADV_WILLNEED loads the pages and ADV_DONTNEED pushes them out.
+   Returns false if a page to be loaded is not mapped or can't be
+   loaded. */
+static bool
+advise_pages(struct thread *t, uint8_t *upage, size_t page_cnt, int advice)
+{
+  for(size_t i = 0; i < page_cnt; i++, upage += PGSIZE)
+    {
+      struct page *p = page_lookup(&t->pages, upage);
+      if(p == NULL)
+	{
+	  struct vma *v;
+	  if(advice != ADV_WILLNEED)
+	    continue;
+	  v = vma_find(&t->vmas, upage);
+	  if(v == NULL || (p = vma_get_page(v, upage)) == NULL)
+	    return false;
+	}
+      if(advice == ADV_WILLNEED)
+	{
+	  if(pagedir_get_page(t->pagedir, upage) == NULL && !page_load(p))
+	    return false;
+	}
+      else if(advice == ADV_DONTNEED)
+	page_evict(p);
+      else
+	p->advice = advice;
+    }
+  return true;
+}
+
+/* Implements madvise(): ADDR must be page-aligned and LENGTH
+   bytes from ADDR must lie in user memory, every page of it
+   either in a region or already faulted in.  ADV_NORMAL,
+   ADV_SEQUENTIAL and ADV_RANDOM are recorded on the regions the
+   range covers, split at its ends, so that the pages not yet
+   touched need no descriptor until they fault. */
+static int
+madvise(struct thread *t, void *addr, unsigned length, int advice)
+{
+  uint8_t *start = addr, *end, *upage;
+
+  if(pg_ofs(addr) != 0 || addr == NULL
+     || (uint8_t *) PHYS_BASE - start < (ptrdiff_t) length
+     || advice < ADV_NORMAL || advice > ADV_DONTNEED)
+    return -1;
+  end = start + ROUND_UP(length, PGSIZE);
+  for(upage = start; upage < end; )
+    {
+      struct vma *v = vma_find(&t->vmas, upage);
+      if(v == NULL)
+	{
+	  if(page_lookup(&t->pages, upage) == NULL)
+	    return -1;
+	  upage += PGSIZE;
+	  continue;
+	}
+      if(advice <= ADV_RANDOM)
+	{
+	  if(v->start < upage && (v = vma_split(v, upage)) == NULL)
+	    return -1;
+	  if(v->end > end && vma_split(v, end) == NULL)
+	    return -1;
+	  v->advice = advice;
+	}
+      upage = v->end;
+    }
+  return advise_pages(t, start, (end - start) / PGSIZE, advice) ? 0 : -1;
+}
+
+/* Implements fadvise(): records ADVICE for the file open as FD,
+   if it describes an access pattern, and applies it to the pages
+   of T's mappings of that file that cover the LENGTH bytes
+   starting at OFFSET.  A LENGTH of 0 means through end of file. */
+static int
+fadvise(struct thread *t, int fd, off_t offset, off_t length, int advice)
+{
+  struct file *fd_file = search_fd(t, fd);
+  struct inode *inode;
+  struct list_elem *e;
+
+  if(fd_file == NULL || offset < 0 || length < 0
+     || advice < ADV_NORMAL || advice > ADV_DONTNEED)
+    return -1;
+  inode = file_get_inode(fd_file);
+  if(advice <= ADV_RANDOM)
+    inode_set_advice(inode, advice);
+
+  for(e = list_begin(&t->vmas); e != list_end(&t->vmas); e = list_next(e))
+    {
+      struct vma *v = list_entry(e, struct vma, elem);
+      off_t start, end;
+
+      if(v->file == NULL || file_get_inode(v->file) != inode)
+	continue;
+      start = offset > v->ofs ? offset : v->ofs;
+      end = v->ofs + (off_t) v->read_bytes;
+      if(length > 0 && offset + length < end)
+	end = offset + length;
+      if(start >= end)
+	continue;
+      start = ROUND_DOWN(start - v->ofs, PGSIZE);
+      advise_pages(t, v->start + start,
+		   DIV_ROUND_UP(end - v->ofs - start, PGSIZE), advice);
+    }
+  return 0;
+}
+
+/* Implements blkstat(): copies the statistics of the IDX'th block
+   device, in probe order, to user address UST.  Returns false if
+   there is no such device. */
+static bool
+blkstat(int idx, struct blkstat *ust)
+{
+  struct block *b;
+  struct blkstat st;
+
+  if(idx < 0)
+    return false;
+  for(b = block_first(); b != NULL && idx > 0; b = block_next(b))
+    idx--;
+  if(b == NULL)
+    return false;
+  block_get_stats(b, &st);
+  if(!copy_to_user(ust, &st, sizeof st))
+    exit();
+  return true;
+}
+
 static void
 syscall_handler (struct intr_frame *f UNUSED) 
 {
     int *p = f->esp;
     struct thread *t = thread_current();
-    check_ptr(f->esp);
-    switch(*p){
+    switch(get_user_arg(p, 0)){
     case SYS_HALT:
       {
 	shutdown_power_off();
@@ -199,170 +660,156 @@ syscall_handler (struct intr_frame *f UNUSED)
       }
     case SYS_EXIT:
       {
-	check_ptr(p + 1);
-	int *status = p + 1;
-	f->eax = *status;
-	t->exit_status = *status;
+	int status = get_user_arg(p, 1);
+	f->eax = status;
+	t->exit_status = status;
 	printf("%s: exit(%d)\n", t->name, t->exit_status);
 	thread_exit();
 	break;
       }
     case SYS_WRITE:
       {
-	check_ptr(p + 1);
-	check_ptr(p + 2);
-	check_ptr(p + 3);
-	int fd = *(p + 1);
-	if(isdir(t, fd)) {
-	  f->eax=-1;
-	  break;
-	}
-	const void **buffer = (p + 2);
-	unsigned size = *(p + 3);
-	check_buffer(*buffer, size);
-	pin_page(*buffer, size);
-	//pin_page(f->esp, 0);
-	if(fd == 0)
-	  ;//writing to stdin
-	else if(fd == 1){    
-	  putbuf(*buffer, size);
-	}
-	else {
-	  struct fd_* file_d = search_fd(t, fd);
-	  if(file_d != NULL)
-	    f->eax = file_write(file_d->file, *buffer, size);
-	  else
-	    f->eax = -1;
-	}
-	unpin_page(*buffer, size);
-	//unpin_page(f->esp, 0);
+	f->eax = write_fd(t, get_user_arg(p, 1), (void *) get_user_arg(p, 2),
+			  get_user_arg(p, 3), -1);
 	break;
       }
     case SYS_CREATE:
       {
-	check_ptr(p + 1);
-	check_ptr(p + 2);
-	const char** file = (const char**)(p+1);
-	unsigned initial_size = *(unsigned*)(p+2);
-	check_string(*file);
-	if(**file == '\0'){
+	const char *file = (const char *) get_user_arg(p, 1);
+	unsigned initial_size = get_user_arg(p, 2);
+	check_string(file);
+	if(*file == '\0'){
 	  f->eax=0;
 	  break;
 	}
 	//printf("\n(SYS_CREATE) t->cwd->inode->sector:%d\n",
 	//       t->cwd->inode->sector);
-	f->eax = filesys_create(*file, initial_size, 0);
+	f->eax = filesys_create(file, initial_size, 0);
 	break;
       }
     case SYS_OPEN:
       {
-	check_ptr(p + 1);
-	const char **name = p + 1;
-	check_string(*name);
-	if(**name=='\0'){
+	const char *name = (const char *) get_user_arg(p, 1);
+	check_string(name);
+	if(*name=='\0'){
 	  f->eax=-1;
 	  break;
 	}
-	struct file *file = filesys_open(*name);
-	//printf("(SYS_OPEN) name:%s\n", *name);
+	struct file *file = filesys_open(name);
+	//printf("(SYS_OPEN) name:%s\n", name);
 	if(!file){
 	  //printf("(SYS_OPEN) file==NULL\n");
 	  f->eax = -1;
 	}
 	else{
-	  struct fd_* new_fd = calloc(1, sizeof(struct fd_));
-	  new_fd->fd = t->next_fd;
-	  new_fd->file = file;
-	  list_push_back(&t->files, &new_fd->elem);
-	  f->eax = t->next_fd++;
+	  int fd = alloc_fd(t, file);
+	  if(fd == -1)
+	    file_close(file);
+	  f->eax = fd;
 	}
 	break;
       }
     case SYS_CLOSE:
       {
-	check_ptr(p + 1);
-	int fd = *(p + 1);
-	struct fd_* file_d = search_fd(t, fd);
-	if(file_d != NULL){
-	  list_remove(&file_d->elem);
-	  file_close(file_d->file);
-	  free(file_d);
-	}
+	int fd = get_user_arg(p, 1);
+	close_fd(t, fd);
 	break;
       }
 
     case SYS_FILESIZE:
       {
-	check_ptr(p + 1);
-	int fd = *(p + 1);
-	struct fd_* file_d = search_fd(t, fd);
-	if(file_d != NULL)
-	  f->eax = file_length(file_d->file);
+	int fd = get_user_arg(p, 1);
+	struct file *fd_file = search_fd(t, fd);
+	if(fd_file != NULL)
+	  f->eax = file_length(fd_file);
 	else
 	  f->eax = 0;
 	break;
       }
     case SYS_READ:
       {
-	check_ptr(p + 1);
-	check_ptr(p + 2);
-	check_ptr(p + 3);
-	int fd = *(p + 1);
-	const void **buffer = p + 2;
-	unsigned size = *(p + 3);
-	check_buffer(*buffer, size);
-	pin_page(*buffer, size);
-	//pin_page(f->esp, 0);
-	if(fd == 0){
-	  f->eax = input_getc();
-	}
-	else{
-	  struct fd_ *file_d = search_fd(t, fd);
-	  if(file_d != NULL)
-	    f->eax = file_read(file_d->file, *buffer, size);
-	  else
-	    f->eax = -1;
-	}
-	unpin_page(*buffer, size);
-	//unpin_page(f->esp, 0);
+	f->eax = read_fd(t, get_user_arg(p, 1), (void *) get_user_arg(p, 2),
+			 get_user_arg(p, 3), -1);
+	break;
+      }
+    case SYS_PREAD:
+    case SYS_PWRITE:
+      {
+	int fd = get_user_arg(p, 1);
+	void *buffer = (void *) get_user_arg(p, 2);
+	unsigned size = get_user_arg(p, 3);
+	off_t ofs = get_user_arg(p, 4);
+	if(ofs < 0)
+	  f->eax = -1;
+	else if(get_user_arg(p, 0) == SYS_PREAD)
+	  f->eax = read_fd(t, fd, buffer, size, ofs);
+	else
+	  f->eax = write_fd(t, fd, buffer, size, ofs);
+	break;
+      }
+    case SYS_READV:
+    case SYS_WRITEV:
+      {
+	f->eax = rw_vector(t, get_user_arg(p, 1),
+			   (const struct iovec *) get_user_arg(p, 2),
+			   get_user_arg(p, 3), get_user_arg(p, 0) == SYS_WRITEV);
+	break;
+      }
+    case SYS_MADVISE:
+      {
+	f->eax = madvise(t, (void *) get_user_arg(p, 1), get_user_arg(p, 2),
+			 get_user_arg(p, 3));
+	break;
+      }
+    case SYS_BLKSTAT:
+      {
+	f->eax = blkstat(get_user_arg(p, 1),
+			 (struct blkstat *) get_user_arg(p, 2));
+	break;
+      }
+    case SYS_FADVISE:
+      {
+	f->eax = fadvise(t, get_user_arg(p, 1), get_user_arg(p, 2),
+			 get_user_arg(p, 3), get_user_arg(p, 4));
+	break;
+      }
+    case SYS_COPY_FILE_RANGE:
+      {
+	f->eax = copy_file_range(t, get_user_arg(p, 1), get_user_arg(p, 2),
+				 get_user_arg(p, 3));
 	break;
       }
     case SYS_REMOVE:
       {
-	check_ptr(p + 1);
-	const char **file = p + 1;
-	check_string(*file);
-	f->eax = filesys_remove(*file);
+	const char *file = (const char *) get_user_arg(p, 1);
+	check_string(file);
+	f->eax = filesys_remove(file);
 	//printf("EXITED filesys_remove, f->eax:%d\n", f->eax);
 	break;
       }
     case SYS_SEEK:
       {
-	check_ptr(p + 1);
-	check_ptr(p + 2);
-	int fd = *(p + 1);
-	unsigned pos = *(p + 2);
-	struct fd_* file_d = search_fd(t, fd);
-	if(file_d != NULL)
-	  file_d->file->pos = pos;
+	int fd = get_user_arg(p, 1);
+	unsigned pos = get_user_arg(p, 2);
+	struct file *fd_file = search_fd(t, fd);
+	if(fd_file != NULL)
+	  fd_file->pos = pos;
 	break;
       }
     case SYS_TELL:
       {
-	check_ptr(p + 1);
-	int fd = *(p + 1);
-	struct fd_* file_d = search_fd(t, fd);
-	if(file_d != NULL)
-	  f->eax = file_d->file->pos;
+	int fd = get_user_arg(p, 1);
+	struct file *fd_file = search_fd(t, fd);
+	if(fd_file != NULL)
+	  f->eax = fd_file->pos;
 	break;
       }
     case SYS_EXEC:
       {
 	// dummy implemetation, still didn't implement synchronization
-	check_ptr(p + 1);
-	const char **cmd_line = p + 1;
-	check_string(*cmd_line);
-	f->eax = process_execute(*cmd_line);
+	const char *cmd_line = (const char *) get_user_arg(p, 1);
+	check_string(cmd_line);
+	f->eax = process_execute(cmd_line);
 	sema_down(&t->wait);
 	if(!t->load_child){
 	  t->load_child = true;
@@ -372,8 +819,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       }
     case SYS_WAIT:
       {
-	check_ptr(p + 1);
-	int tid = *(p + 1);
+	int tid = get_user_arg(p, 1);
 	//printf("Process %s waits for tid %d\n",thread_current()->name, tid);
 	f->eax = process_wait(tid);
 	//printf("End of SYS_WAIT\n");
@@ -381,60 +827,47 @@ syscall_handler (struct intr_frame *f UNUSED)
       }
     case SYS_MMAP:
       {
-	check_ptr(p + 1);
-	check_ptr(p + 2);
-	int fd = *(p + 1);
-	uint8_t *addr = *(p + 2);
-	struct fd_ *file_d = search_fd(t, fd);
-	if(!fd){
+	int fd = get_user_arg(p, 1);
+	uint8_t *addr = (uint8_t *) get_user_arg(p, 2);
+	struct file *fd_file = search_fd(t, fd);
+	if(fd_file == NULL){
 	  f->eax = -1;
 	  break;
 	}
-	size_t file_size = file_length(file_d->file);
+	size_t file_size = file_length(fd_file);
 	size_t pages = (file_size / PGSIZE) + 1;
-	size_t last_read = file_size % PGSIZE;
 	uint8_t *last_addr = addr + pages * PGSIZE;
 	// account for stack overlap
 	if( addr == NULL || file_size == 0 || (unsigned) addr % PGSIZE != 0 ||  \
 	    pagedir_get_page(t->pagedir, addr) || page_lookup(&t->pages, addr) || \
-	    pagedir_get_page(t->pagedir, last_addr) || page_lookup(&t->pages, last_addr)){
+	    pagedir_get_page(t->pagedir, last_addr) || page_lookup(&t->pages, last_addr) || \
+	    vma_overlaps(&t->vmas, addr, file_size)){
 	  f->eax = -1;
 	  break;
 	}
-	struct map *m = calloc(sizeof(struct map), 1);
+	// pages are read in on first touch
+	struct map *m = kmem_cache_zalloc(map_cache);
+	struct file *file = file_reopen(fd_file);
+	bool writable = fd_file->inode->deny_write_cnt > 0 ? false : true;
+	m->vma = vma_create(&t->vmas, addr, file_size, file, 0, file_size, writable);
+	if(m->vma == NULL){
+	  file_close(file);
+	  kmem_cache_free(map_cache, m);
+	  f->eax = -1;
+	  break;
+	}
+	m->vma->shared = true;
 	m->addr = addr;
 	m->cnt = pages;
-	m->mapid = t->next_fd++;
+	m->mapid = t->next_mapid++;
 	list_push_back(&t->map, &m->list_elem);
-
-	for(int i = 0; i < pages; i++)
-	  {
-	    struct page *p = calloc(sizeof(struct page), 1);
-	    p->upage = addr;
-	    p->file = file_reopen(file_d->file);
-	    p->writable = file_d->file->inode->deny_write_cnt > 0 ? false : true;
-	    p->ofs = i * PGSIZE;
-	    p->kpage = NULL;
-	    if(i != (pages - 1)){
-	      p->read_bytes  = PGSIZE;
-	      p->zero_bytes = 0;
-	    }
-	    else{
-	      p->read_bytes = last_read;
-	      p->zero_bytes = PGSIZE - last_read;
-	    }
-	    hash_insert(&t->pages, &p->hash_elem);
-	    addr += PGSIZE;
-	    //printf("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\n");
-	  }
 	f->eax = m->mapid;
 	break;
       }
     case SYS_MUNMAP:
       {
 	//printf("-----------------------------remove\n");
-	check_ptr(p + 1);
-	unsigned mapid = *(p + 1);
+	unsigned mapid = get_user_arg(p, 1);
 	uint8_t *addr;
 	struct list_elem *e;
 	struct map *m;
@@ -444,19 +877,9 @@ syscall_handler (struct intr_frame *f UNUSED)
 	    if(m->mapid == mapid)
 	      break;
 	  }
-	for(int i = 0; i < m->cnt; i++)
-	  {
-	    struct page *p = page_lookup(&t->pages, m->addr + i * PGSIZE);
-	    if(pagedir_is_dirty(t->pagedir, p->upage))
-	      file_write_at(p->file, p->upage, PGSIZE, p->ofs);
-	    pagedir_clear_page(t->pagedir, p->upage);
-	    palloc_free_page(p->kpage);
-	    hash_delete(&t->pages, &p->hash_elem);
-	    free(p->file);
-	    free(p);
-	  }
-	list_remove(&m->list_elem);
-	free(m);
+	if(e == list_end(&t->map))
+	  break;
+	munmap(t, m);
 	break;
       }
 
@@ -465,9 +888,8 @@ syscall_handler (struct intr_frame *f UNUSED)
 
     case SYS_MKDIR:
       {
-	check_ptr(p+1);
-	check_string(*(p+1));
-	const char* dir_name = *(p+1);
+	const char* dir_name = (const char *) get_user_arg(p, 1);
+	check_string(dir_name);
 	if (!(*dir_name)) {
 	  f->eax=0;
 	  break;
@@ -482,9 +904,8 @@ syscall_handler (struct intr_frame *f UNUSED)
 
     case SYS_CHDIR:
       {
-	check_ptr(p+1);
-	check_string(*(p+1));
-	const char* full_name = *(p+1);
+	const char* full_name = (const char *) get_user_arg(p, 1);
+	check_string(full_name);
 	char* short_name;
 	
 	if (!(*full_name)) {
@@ -586,8 +1007,7 @@ syscall_handler (struct intr_frame *f UNUSED)
 
     case SYS_ISDIR:
       {
-	check_ptr(p + 1);
-	int fd = *(p + 1);
+	int fd = get_user_arg(p, 1);
 	f->eax = isdir(t, fd);
 	break;
 
@@ -596,19 +1016,16 @@ syscall_handler (struct intr_frame *f UNUSED)
       
     case SYS_INUMBER:
       {
-	check_ptr(p + 1);
-	int fd = *(p + 1);
+	int fd = get_user_arg(p, 1);
 	f->eax = inumber(t, fd);
 	break;
       }
 
     case SYS_READDIR:
       {
-	check_ptr(p+1);
-	check_ptr(p+2);
-	check_string(*(p+2));
-	int fd = *(p+1);
-	char *name = *(p+2);
+	int fd = get_user_arg(p, 1);
+	char *name = (char *) get_user_arg(p, 2);
+	check_string(name);
 	f->eax = readdir(t, fd, name);
 	break;
       }
@@ -1,6 +1,19 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
 void syscall_init (void);
 void is_bad_args(int *, int);
+struct thread;
+struct map;
+void munmap(struct thread *, struct map *);
+struct file;
+int alloc_fd(struct thread *, struct file *);
+struct file *search_fd(struct thread *, int);
+void close_fd(struct thread *, int);
+void close_all_fds(struct thread *);
+bool copy_from_user(void *, const void *, size_t);
+bool copy_to_user(void *, const void *, size_t);
 #endif /* userprog/syscall.h */
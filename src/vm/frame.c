@@ -1,15 +1,38 @@
 #include "vm/frame.h"
 #include "vm/swap.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 #include "threads/pte.h"
 #include "userprog/pagedir.h"
+#include "threads/slab.h"
+#include "threads/palloc.h"
 #include "lib/random.h"
+#include <advice.h>
 
 
 extern struct swap swap;
 
+/* Cache of frame table entries. */
+static struct kmem_cache *frame_cache;
+
+void frame_init(void)
+{
+  frame_cache = kmem_cache_create("frame", sizeof(struct frame), NULL);
+}
+
+/* Returns a new, zeroed frame table entry, or NULL if out of memory. */
+struct frame *frame_create(void)
+{
+  return kmem_cache_zalloc(frame_cache);
+}
+
+void frame_destroy(struct frame *f)
+{
+  kmem_cache_free(frame_cache, f);
+}
+
 unsigned frame_hash(const struct hash_elem *e, void* aux)
 {
   const struct frame *f = hash_entry(e, struct frame, hash_elem);
@@ -25,8 +48,8 @@ bool frame_less(const struct hash_elem *a, const struct hash_elem *b, void *aux)
 
 void frame_free(const struct hash_elem *e, void *aux)
 {
-  const struct frame *f = hash_entry(e, struct frame, hash_elem);
-  free(f);
+  struct frame *f = hash_entry(e, struct frame, hash_elem);
+  frame_destroy(f);
 }
 
 struct frame* frame_lookup(struct hash *frames, const uint8_t *kpage)
@@ -39,6 +62,18 @@ struct frame* frame_lookup(struct hash *frames, const uint8_t *kpage)
   return e != NULL ? hash_entry(e, struct frame, hash_elem) : NULL;
 }
 
+/* Removes the entry for KPAGE, if any, from FRAMES and frees it.
+   The caller must hold swap.lock. */
+void frame_remove(struct hash *frames, const uint8_t *kpage)
+{
+  struct frame *f = frame_lookup(frames, kpage);
+  if(f != NULL)
+    {
+      hash_delete(frames, &f->hash_elem);
+      frame_destroy(f);
+    }
+}
+
 void print_all_frames(const struct hash *hash)
 {
   printf("size of hash is %d\n", hash_size(hash));
@@ -51,34 +86,75 @@ void print_all_frames(const struct hash *hash)
   }
 }
 
+/* Writes F's page to swap if it is writable, or back to its file
+   if it is a dirty page of a memory-mapped file, unmaps it, and
+   removes F from FRAMES.  The caller must hold swap.lock. */
+static void evict(struct hash *frames, struct frame *f)
+{
+  struct page *p = page_lookup(f->spt, f->upage);
+  trace(TRACE_EVICT, (uint32_t) f->upage, f->tid, p->writable);
+  if(p->shared)
+    {
+      /* Unmap before writing, as swap_write() does, so that a
+	 write to the page during the file write faults. */
+      bool dirty = pagedir_is_dirty(f->pd, f->upage);
+      pagedir_clear_page(f->pd, f->upage);
+      p->kpage = NULL;
+      if(dirty)
+	file_write_at(p->file, f->kpage, p->read_bytes, p->ofs);
+    }
+  else if(p->writable)
+    swap_write(&swap, f);
+  else
+    pagedir_clear_page(f->pd, f->upage);
+  hash_delete(frames, &f->hash_elem);
+  frame_destroy(f);
+}
+
+/* Picks a victim frame with the clock algorithm, evicts it, and
+   returns its kernel page.  Pages marked ADV_SEQUENTIAL are
+   expected to be used once, so they get no second chance, which
+   keeps a streaming scan from pushing out the working set.  The
+   sweep clears accessed bits in a TLB flush batch, which is
+   flushed before the victim's frame is handed back. */
 void *frame_evict(struct hash *frames, int page_cnt)
 {
   void *kpage =  NULL;
+  struct tlb_batch batch;
   //lock_acquire(&swap.lock);
   struct hash_iterator i;
+  pagedir_batch_begin(&batch);
   hash_first(&i, frames);
   while(!kpage){
     while(hash_next(&i))
       {
 	struct frame *f = hash_entry(hash_cur(&i), struct frame, hash_elem);
-	struct page *p = page_lookup(f->hash, f->upage);
-	if(p->lock || pagedir_is_accessed(f->pd, f->upage))
+	struct page *p = page_lookup(f->spt, f->upage);
+	if(p->pin_cnt > 0 || (p->advice != ADV_SEQUENTIAL
+			      && pagedir_is_accessed(f->pd, f->upage)))
 	  pagedir_set_accessed(f->pd, f->upage, false);
 	else{
-	  if(p->writable)
-	    swap_write(&swap, f);
-	  else
-	    pagedir_clear_page(f->pd, f->upage);
 	  kpage = (void*)f->kpage;
-	  hash_delete(frames, &f->hash_elem);
+	  evict(frames, f);
 	  //lock_release(&swap.lock);
-	  free(f);
 	  break;
 	  }
       }
     if(!kpage)
       hash_first(&i, frames);
   }
+  pagedir_batch_end(&batch);
   return kpage;
 }
 
+/* Evicts the frame holding KPAGE, if any, as frame_evict() would,
+   and returns KPAGE to the user pool.  The caller must hold
+   swap.lock. */
+void frame_release(struct hash *frames, const uint8_t *kpage)
+{
+  struct frame *f = frame_lookup(frames, kpage);
+  if(f == NULL)
+    return;
+  evict(frames, f);
+  palloc_free_page((void *) kpage);
+}
@@ -9,14 +9,19 @@ struct frame{
   uint32_t *pd;
   uint8_t *upage;
   uint8_t *kpage;
-  struct hash *hash
+  struct spt *spt;
 };
 
+void frame_init(void);
+struct frame *frame_create(void);
+void frame_destroy(struct frame *);
 unsigned frame_hash(const struct hash_elem *, void *);
 bool frame_less(const struct hash_elem *, const struct hash_elem *, void *);
 void frame_free(const struct hash_elem *, void *);
 struct frame *frame_lookup(struct hash *, const uint8_t *);
+void frame_remove(struct hash *, const uint8_t *);
 void print_all_frames(const struct hash *);
 void *frame_evict(struct hash* ,  int );
+void frame_release(struct hash *, const uint8_t *);
 
 #endif
@@ -1,56 +1,474 @@
 #include "vm/page.h"
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/pte.h"
+#include "threads/tsc.h"
 #include "vm/frame.h"
+#include "vm/swap.h"
+#include "vm/vma.h"
+#include "threads/palloc.h"
+#include "userprog/pagedir.h"
 
-unsigned page_hash(const struct hash_elem *e, void* aux)
+/* A page of supplemental page table entries.  The entries
+   themselves follow this header. */
+struct page_chunk{
+  struct page_chunk *next;
+};
+
+/* Number of entries that fit in a chunk. */
+#define CHUNK_PAGES ((PGSIZE - sizeof(struct page_chunk)) / sizeof(struct page))
+
+void page_arena_init(struct page_arena *a)
+{
+  a->chunks = NULL;
+  a->used = 0;
+  a->free = NULL;
+  a->chunk_cnt = 0;
+}
+
+/* Returns a new, zeroed entry from arena A, or NULL if out of
+   memory.  Entries released with page_arena_free() are reused
+   first; otherwise the next unused entry of the current chunk is
+   handed out, starting a new chunk when it fills up. */
+struct page *page_arena_alloc(struct page_arena *a)
 {
-  const struct page *p = hash_entry(e, struct page, hash_elem);
-  return hash_int(p->upage);//hash_bytes(&p->upage, sizeof p->upage);
-  
+  struct page *p;
+  if(a->free != NULL)
+    {
+      p = a->free;
+      a->free = *(struct page **) p;
+    }
+  else
+    {
+      if(a->chunks == NULL || a->used == CHUNK_PAGES)
+	{
+	  struct page_chunk *c = palloc_get_page(0);
+	  if(c == NULL)
+	    return NULL;
+	  c->next = a->chunks;
+	  a->chunks = c;
+	  a->used = 0;
+	  a->chunk_cnt++;
+	}
+      p = (struct page *)(a->chunks + 1) + a->used++;
+    }
+  memset(p, 0, sizeof *p);
+  return p;
 }
-bool page_less(const struct hash_elem *a, const struct hash_elem *b, void *aux)
+
+/* Returns P, which must not be in any page table, to arena A
+   for reuse.  Its memory is not given back until the arena is
+   destroyed.  While free, P's first word links it to the next
+   free entry. */
+void page_arena_free(struct page_arena *a, struct page *p)
 {
-  const struct page *p1 = hash_entry(a, struct page, hash_elem);
-  const struct page *p2 = hash_entry(b, struct page, hash_elem);
-  return p1->upage < p2->upage;
+  *(struct page **) p = a->free;
+  a->free = p;
 }
-void page_free(const struct hash_elem *e, void *aux)
+
+/* Releases every entry of arena A at once, one page per chunk. */
+void page_arena_destroy(struct page_arena *a)
 {
-  const struct page *p = hash_entry(e, struct page, hash_elem);
-  free(p);
+  while(a->chunks != NULL)
+    {
+      struct page_chunk *c = a->chunks;
+      a->chunks = c->next;
+      palloc_free_page(c);
+    }
+  page_arena_init(a);
 }
-struct page* page_lookup(struct hash *hash, const uint8_t *upage)
+
+/* Returns a new, zeroed entry for the current process, or NULL
+   if out of memory. */
+struct page *page_create(void)
 {
-  struct page *p = calloc(sizeof(struct page), 1);
-  struct hash_elem *e;
-  p->upage = (uint32_t) upage & ~PGMASK;
-  e = hash_find(hash, &p->hash_elem);
-  free(p);
-  return e != NULL ? hash_entry(e, struct page, hash_elem) : NULL;
+  return page_arena_alloc(&thread_current()->spt_arena);
 }
 
-void print_all_pages(const struct hash *hash)
+void page_destroy(struct page *p)
 {
-  struct hash_iterator i;
-  int j = 0;
-  hash_first(&i, hash);
-  while(hash_next(&i)){
-    struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
-    printf("Element %d with address %x\n", ++j, p->upage);
-  }
+  page_arena_free(&thread_current()->spt_arena, p);
 }
 
-void remove_frames(const struct hash *pages, const struct hash *frames)
+/* Number of directory slots: one per 4 MB of user memory. */
+#define SPT_DIR_CNT pd_no(PHYS_BASE)
+
+void spt_init(struct spt *spt)
+{
+  spt->dir = NULL;
+  spt->cnt = 0;
+  spt->table_cnt = 0;
+}
+
+/* Returns the slot for UPAGE in SPT.  If CREATE is true,
+   allocates the directory and table as needed, returning NULL
+   only if out of memory; otherwise returns NULL if there is no
+   table for UPAGE. */
+static struct page **spt_slot(struct spt *spt, const void *upage, bool create)
+{
+  struct page **table;
+  ASSERT(is_user_vaddr(upage));
+
+  if(spt->dir == NULL)
+    {
+      if(!create)
+	return NULL;
+      spt->dir = palloc_get_page(PAL_ZERO);
+      if(spt->dir == NULL)
+	return NULL;
+    }
+  table = spt->dir[pd_no(upage)];
+  if(table == NULL)
+    {
+      if(!create)
+	return NULL;
+      table = palloc_get_page(PAL_ZERO);
+      if(table == NULL)
+	return NULL;
+      spt->dir[pd_no(upage)] = table;
+      spt->table_cnt++;
+    }
+  return &table[pt_no(upage)];
+}
+
+/* Adds P to SPT under P->upage.  Returns false if an entry for
+   that page already exists or if out of memory. */
+bool spt_insert(struct spt *spt, struct page *p)
+{
+  struct page **slot = spt_slot(spt, p->upage, true);
+  if(slot == NULL || *slot != NULL)
+    return false;
+  *slot = p;
+  spt->cnt++;
+  return true;
+}
+
+/* Removes P from SPT, if present.  Empty tables are kept until
+   spt_destroy(). */
+void spt_remove(struct spt *spt, struct page *p)
+{
+  struct page **slot = spt_slot(spt, p->upage, false);
+  if(slot != NULL && *slot == p)
+    {
+      *slot = NULL;
+      spt->cnt--;
+    }
+}
+
+/* Calls ACTION on every entry in SPT in ascending address order.
+   ACTION may remove the entry it is passed, but not others. */
+void spt_foreach(struct spt *spt, page_action_func *action, void *aux)
+{
+  size_t i, j;
+  if(spt->dir == NULL)
+    return;
+  for(i = 0; i < SPT_DIR_CNT; i++)
+    {
+      struct page **table = spt->dir[i];
+      if(table == NULL)
+	continue;
+      for(j = 0; j < PGSIZE / sizeof *table; j++)
+	if(table[j] != NULL)
+	  action(table[j], aux);
+    }
+}
+
+/* Frees SPT's directory and tables.  The entries themselves
+   belong to the process's arena and are not touched. */
+void spt_destroy(struct spt *spt)
+{
+  size_t i;
+  if(spt->dir == NULL)
+    return;
+  for(i = 0; i < SPT_DIR_CNT; i++)
+    if(spt->dir[i] != NULL)
+      palloc_free_page(spt->dir[i]);
+  palloc_free_page(spt->dir);
+  spt_init(spt);
+}
+
+struct page* page_lookup(struct spt *spt, const uint8_t *upage)
+{
+  struct page **slot;
+  if(!is_user_vaddr(upage))
+    return NULL;
+  slot = spt_slot(spt, upage, false);
+  return slot != NULL ? *slot : NULL;
+}
+
+extern struct swap swap;
+extern struct hash frames;
+extern uint8_t *stack_end;
+
+/* Brings P into memory in a new frame, from swap, its file, or
+   as zeros, and maps it in the current process.  Returns false
+   if out of memory or if the file read falls short. */
+bool page_load(struct page *p)
+{
+  uint8_t *kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+  if(kpage == NULL)
+    return false;
+  p->kpage = kpage;
+  if(p->swap)
+    {
+      swap_read(&swap, p);
+      p->swap = false;
+    }
+  else if(p->file != NULL)
+    {
+      if(file_read_at(p->file, kpage, p->read_bytes, p->ofs) != (int) p->read_bytes)
+	{
+	  palloc_free_page(kpage);
+	  return false;
+	}
+      memset(kpage + p->read_bytes, 0, p->zero_bytes);
+    }
+  else
+    memset(kpage + p->read_bytes, 0, p->zero_bytes);
+  if(!pagedir_set_page(thread_current()->pagedir, p->upage, kpage, p->writable))
+    {
+      palloc_free_page(kpage);
+      return false;
+    }
+  return true;
+}
+
+/* Pins the SIZE bytes of user memory at ADDR, which the caller
+   has already validated, in a single pass over the pages they
+   span.  Each page gets a descriptor if it doesn't have one yet:
+   from its VMA, or else as a new stack page.  It is then brought
+   in if needed.  Pinned pages are skipped by frame_evict().  Pins
+   nest, so a page stays pinned until every pin of it is undone
+   with page_unpin().  Fills in PIN with the pinned pages, so
+   that page_unpin() needn't look them up again.  Returns false
+   if out of memory, leaving nothing pinned. */
+bool page_pin(struct page_pin *pin, const void *addr, size_t size)
+{
+  struct thread *t = thread_current();
+  uint8_t *upage = pg_round_down(addr);
+  size_t i;
+
+  pin->page_cnt = size == 0 ? 0
+    : ((uint8_t *) pg_round_down((const uint8_t *) addr + size - 1) - upage)
+      / PGSIZE + 1;
+  pin->pages = pin->inline_pages;
+  if(pin->page_cnt > PAGE_PIN_INLINE)
+    {
+      pin->pages = malloc(pin->page_cnt * sizeof *pin->pages);
+      if(pin->pages == NULL)
+	{
+	  pin->page_cnt = 0;
+	  return false;
+	}
+    }
+  for(i = 0; i < pin->page_cnt; i++, upage += PGSIZE)
+    {
+      struct page *p = page_lookup(&t->pages, upage);
+      if(p == NULL)
+	{
+	  struct vma *v = vma_find(&t->vmas, upage);
+	  if(v != NULL)
+	    p = vma_get_page(v, upage);
+	  else if((p = page_create()) != NULL)
+	    {
+	      p->upage = upage;
+	      p->zero_bytes = PGSIZE;
+	      p->writable = true;
+	      if(!spt_insert(&t->pages, p))
+		{
+		  page_destroy(p);
+		  p = NULL;
+		}
+	      else if(upage < stack_end)
+		stack_end = upage;
+	    }
+	}
+      if(p == NULL)
+	break;
+
+      /* Pin before checking for and loading the frame, under
+	 the lock that frame_evict() holds, so that it can't be
+	 evicted from under us. */
+      bool present;
+      lock_acquire(&swap.lock);
+      p->pin_cnt++;
+      present = pagedir_get_page(t->pagedir, upage) != NULL;
+      lock_release(&swap.lock);
+      if(!present && !page_load(p))
+	{
+	  p->pin_cnt--;
+	  break;
+	}
+      pin->pages[i] = p;
+    }
+  if(i < pin->page_cnt)
+    {
+      pin->page_cnt = i;
+      page_unpin(pin);
+      return false;
+    }
+  return true;
+}
+
+/* Undoes page_pin(PIN). */
+void page_unpin(struct page_pin *pin)
+{
+  size_t i;
+
+  for(i = 0; i < pin->page_cnt; i++)
+    {
+      ASSERT(pin->pages[i]->pin_cnt > 0);
+      pin->pages[i]->pin_cnt--;
+    }
+  if(pin->pages != pin->inline_pages)
+    free(pin->pages);
+  pin->pages = pin->inline_pages;
+  pin->page_cnt = 0;
+}
+
+/* Pushes P, a page of the current process, out of memory now,
+   as frame_evict() would.  Does nothing if P is pinned or not
+   present. */
+void page_evict(struct page *p)
+{
+  struct thread *t = thread_current();
+  uint8_t *kpage;
+
+  lock_acquire(&swap.lock);
+  kpage = pagedir_get_page(t->pagedir, p->upage);
+  if(kpage != NULL && p->pin_cnt == 0)
+    frame_release(&frames, kpage);
+  lock_release(&swap.lock);
+}
+
+static void print_page(struct page *p, void *aux)
+{
+  int *j = aux;
+  printf("Element %d with address %x\n", ++*j, p->upage);
+}
+
+void print_all_pages(struct spt *spt)
 {
-  struct hash_iterator i;
   int j = 0;
-  hash_first(&i, pages);
-  while(hash_next(&i)){
-    struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
-    struct frame *f = frame_lookup(frames, p->kpage);
-    if(f != NULL){
-      palloc_free_page(f->kpage);
-    }
-  }
+  spt_foreach(spt, print_page, &j);
+}
+
+/* Microbenchmark comparing the radix table against the hash
+   table it replaced. */
+
+/* Hash table entry keyed by user page, laid out like the old
+   supplemental page table entry. */
+struct bench_page{
+  struct hash_elem elem;
+  uint8_t *upage;
+};
+
+static unsigned bench_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int((int) hash_entry(e, struct bench_page, elem)->upage);
+}
+
+static bool bench_less(const struct hash_elem *a, const struct hash_elem *b,
+		       void *aux UNUSED)
+{
+  return (hash_entry(a, struct bench_page, elem)->upage
+	  < hash_entry(b, struct bench_page, elem)->upage);
+}
+
+static void bench_free(struct hash_elem *e, void *aux UNUSED)
+{
+  free(hash_entry(e, struct bench_page, elem));
+}
+
+/* Number of lookups timed per table. */
+#define BENCH_LOOKUPS 100000
+
+/* Seed for bench_random(), so both tables see the same lookups. */
+#define BENCH_SEED 2463534242u
+
+/* Returns the next number from the xorshift generator in *STATE.
+   page_benchmark() uses its own generator rather than reseeding
+   the kernel's. */
+static uint32_t bench_random(uint32_t *state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/* Maps PAGE_CNT pages, spread over a code/data region near the
+   bottom of user memory and a stack region at the top, in both a
+   radix table and a hash table, then times random lookups in
+   each and prints cycles per lookup and bytes of index overhead
+   per mapped page. */
+void page_benchmark(size_t page_cnt)
+{
+  struct page_arena arena;
+  struct spt spt;
+  struct hash hash;
+  uint8_t **addrs;
+  uint64_t start, spt_cycles, hash_cycles;
+  size_t hash_bytes, spt_bytes;
+  size_t i, found;
+  uint32_t seed;
+
+  ASSERT(page_cnt > 0);
+  addrs = malloc(page_cnt * sizeof *addrs);
+  if(addrs == NULL)
+    PANIC("page_benchmark: out of memory");
+  page_arena_init(&arena);
+  spt_init(&spt);
+  hash_init(&hash, bench_hash, bench_less, NULL);
+
+  for(i = 0; i < page_cnt; i++)
+    {
+      struct page *p = page_arena_alloc(&arena);
+      struct bench_page *b = malloc(sizeof *b);
+      if(p == NULL || b == NULL)
+	PANIC("page_benchmark: out of memory");
+      if(i % 8 == 7)
+	addrs[i] = (uint8_t *) PHYS_BASE - (i / 8 + 1) * PGSIZE;
+      else
+	addrs[i] = (uint8_t *) 0x08048000 + (i - i / 8) * PGSIZE;
+      p->upage = b->upage = addrs[i];
+      if(!spt_insert(&spt, p) || hash_insert(&hash, &b->elem) != NULL)
+	PANIC("page_benchmark: out of memory or duplicate page");
+    }
+
+  seed = BENCH_SEED;
+  found = 0;
+  start = rdtsc();
+  for(i = 0; i < BENCH_LOOKUPS; i++)
+    found += page_lookup(&spt, addrs[bench_random(&seed) % page_cnt]) != NULL;
+  spt_cycles = rdtsc() - start;
+
+  seed = BENCH_SEED;
+  start = rdtsc();
+  for(i = 0; i < BENCH_LOOKUPS; i++)
+    {
+      struct bench_page key;
+      key.upage = addrs[bench_random(&seed) % page_cnt];
+      found += hash_find(&hash, &key.elem) != NULL;
+    }
+  hash_cycles = rdtsc() - start;
+  ASSERT(found == 2 * BENCH_LOOKUPS);
+
+  spt_bytes = (spt.table_cnt + 1) * PGSIZE;
+  hash_bytes = page_cnt * sizeof(struct bench_page)
+    + hash.bucket_cnt * sizeof(struct list);
+  printf("SPT benchmark: %zu pages, %d lookups\n", page_cnt, BENCH_LOOKUPS);
+  printf("  radix: %llu cycles/lookup, %zu tables, %zu bytes/page\n",
+	 spt_cycles / BENCH_LOOKUPS, spt.table_cnt, spt_bytes / page_cnt);
+  printf("  hash:  %llu cycles/lookup, %zu buckets, %zu bytes/page\n",
+	 hash_cycles / BENCH_LOOKUPS, hash.bucket_cnt, hash_bytes / page_cnt);
+
+  hash_destroy(&hash, bench_free);
+  spt_destroy(&spt);
+  page_arena_destroy(&arena);
+  free(addrs);
 }
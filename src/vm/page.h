@@ -1,12 +1,11 @@
 #ifndef PAGE_H
 #define PAGE_H
 
-#include <hash.h>
+#include <stddef.h>
 #include "filesys/file.h"
 #include "threads/malloc.h"
 
 struct page{
-  struct hash_elem hash_elem;
   bool swap;
   uint8_t* kpage;
   uint8_t* upage;
@@ -15,17 +14,67 @@ struct page{
   uint32_t read_bytes;
   uint32_t zero_bytes;
   bool writable;
-  bool lock;
+  bool shared;                  /* Dirty data goes back to FILE, not swap. */
+  unsigned pin_cnt;             /* Pinned if nonzero; see page_pin(). */
+  int advice;                   /* ADV_* hint from madvise()/fadvise(). */
 };
 
+/* Number of page pointers a page_pin holds without malloc(). */
+#define PAGE_PIN_INLINE 8
 
-unsigned page_hash(const struct hash_elem *, void*);
-bool page_less(const struct hash_elem *, const struct hash_elem *, void *);
-void page_free(const struct hash_elem *, void *);
-struct page* page_lookup(struct hash *, const uint8_t *);
-void print_all_pages(const struct hash *);
-void remove_frames(const struct hash *, const struct hash *);
+/* A pinned range of user pages, from page_pin(). */
+struct page_pin{
+  struct page **pages;          /* Pinned pages, in address order:
+                                   inline_pages or malloc()'d. */
+  size_t page_cnt;              /* Number of pages. */
+  struct page *inline_pages[PAGE_PIN_INLINE];
+};
+
+/* Supplemental page table.  A two-level radix tree laid out like
+   the x86 page directory: the directory has one slot per 4 MB of
+   user address space, each pointing to a page-sized table of
+   page descriptor pointers for that 4 MB.  A lookup is two array
+   indexes.  Tables are allocated on first use. */
+struct spt{
+  struct page ***dir;           /* Directory, or NULL if empty. */
+  size_t cnt;                   /* Number of entries. */
+  size_t table_cnt;             /* Number of second-level tables. */
+};
+
+/* Per-process bump allocator for supplemental page table
+   entries.  Entries are carved out of whole pages in order and
+   are only returned to the page allocator all at once, by
+   page_arena_destroy(). */
+struct page_arena{
+  struct page_chunk *chunks;    /* Chunks, most recent first. */
+  size_t used;                  /* Entries handed out from CHUNKS. */
+  struct page *free;            /* Entries released by page_arena_free(). */
+  size_t chunk_cnt;             /* Number of chunks. */
+};
+
+void page_arena_init(struct page_arena *);
+struct page *page_arena_alloc(struct page_arena *);
+void page_arena_free(struct page_arena *, struct page *);
+void page_arena_destroy(struct page_arena *);
+
+typedef void page_action_func(struct page *, void *aux);
+
+void spt_init(struct spt *);
+bool spt_insert(struct spt *, struct page *);
+void spt_remove(struct spt *, struct page *);
+void spt_foreach(struct spt *, page_action_func *, void *aux);
+void spt_destroy(struct spt *);
+
+struct page *page_create(void);
+void page_destroy(struct page *);
+struct page* page_lookup(struct spt *, const uint8_t *);
+void print_all_pages(struct spt *);
+bool page_load(struct page *);
+bool page_pin(struct page_pin *, const void *, size_t);
+void page_unpin(struct page_pin *);
+void page_evict(struct page *);
+void page_benchmark(size_t);
 
 #endif
 
-  
+
@@ -9,6 +9,7 @@
 #include <string.h>
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
 #include "devices/block.h"
@@ -26,6 +27,7 @@ void swap_init(struct swap *swap)
   size_t page_cnt  = b_size / BLOCK_PER_PG;
   swap->bitmap = bitmap_create(page_cnt);
   lock_init(&swap->lock);
+  lock_set_name(&swap->lock, "swap");
 }
 
 void swap_write(struct swap *swap, struct frame *f)
@@ -33,41 +35,78 @@ void swap_write(struct swap *swap, struct frame *f)
   size_t page_idx = bitmap_scan_and_flip(swap->bitmap, 0, 1, false);
   size_t block_idx = page_idx * BLOCK_PER_PG;
   // update supplemental page table
-  struct page *p =  page_lookup(f->hash, f->upage);
+  struct page *p =  page_lookup(f->spt, f->upage);
   ASSERT(f->kpage == p->kpage);
   p->swap = true;
   p->ofs = block_idx;
   pagedir_clear_page(f->pd, f->upage);
   p->kpage = NULL;
-  uint8_t *kpage = f->kpage;
-  // write page to swap
-  for(size_t i = block_idx; i < block_idx + BLOCK_PER_PG; i++)
-    {
-      block_write(swap->block, i, kpage);
-      kpage += BLOCK_SECTOR_SIZE;
-    }
+  trace(TRACE_SWAP_WRITE, (uint32_t) f->upage, block_idx, 0);
+  // write page to swap, as one merged request
+  block_write_multiple(swap->block, block_idx, f->kpage, BLOCK_PER_PG);
 }
+/* Reads P's page back from swap and frees its slot.  The slot
+   belongs to P until it is freed, so the read needs no lock, and
+   swap-ins can overlap evictions and each other. */
 void swap_read(struct swap *swap, struct page *p)
 {
-  lock_acquire(&swap->lock);
   size_t block_idx = p->ofs;
   size_t page_idx = p->ofs / BLOCK_PER_PG;
-  uint8_t *kpage = p->kpage;
-  for(size_t i = block_idx; i < block_idx + BLOCK_PER_PG; i++)
-    {
-      block_read(swap->block, i, kpage);
-      kpage += BLOCK_SECTOR_SIZE;
-    }
+  trace(TRACE_SWAP_READ, (uint32_t) p->upage, block_idx, 0);
+  block_read_multiple(swap->block, block_idx, p->kpage, BLOCK_PER_PG);
+  lock_acquire(&swap->lock);
   bitmap_set(swap->bitmap, page_idx, false);
   lock_release(&swap->lock);
 }
-void swap_remove(struct swap *swap, struct hash *pages)
+/* Frees P's swap slot without reading it back, for a page that
+   is being discarded. */
+void swap_free(struct swap *swap, struct page *p)
+{
+  ASSERT(p->swap);
+  lock_acquire(&swap->lock);
+  bitmap_reset(swap->bitmap, p->ofs / BLOCK_PER_PG);
+  lock_release(&swap->lock);
+  p->swap = false;
+}
+/* Number of swap slots swap_remove() frees per acquisition of
+   the swap lock. */
+#define SLOT_BATCH 64
+
+/* Swap slots gathered by swap_remove(). */
+struct slot_batch{
+  struct swap *swap;
+  size_t cnt;
+  size_t slots[SLOT_BATCH];
+};
+static void free_slots(struct slot_batch *b)
+{
+  size_t i;
+  lock_acquire(&b->swap->lock);
+  for(i = 0; i < b->cnt; i++)
+    bitmap_reset(b->swap->bitmap, b->slots[i]);
+  lock_release(&b->swap->lock);
+  b->cnt = 0;
+}
+static void swap_release(struct page *p, void *b_)
+{
+  struct slot_batch *b = b_;
+  if(!p->swap)
+    return;
+  b->slots[b->cnt++] = p->ofs / BLOCK_PER_PG;
+  if(b->cnt == SLOT_BATCH)
+    free_slots(b);
+}
+/* Frees the swap slots held by the pages in PAGES, which must
+   belong to a process whose frames are already gone, so that
+   none of its pages can be swapped out meanwhile.  SWAP's lock is
+   taken once per SLOT_BATCH slots, as pagedir_destroy() does for
+   frames, so faulting threads don't wait for the whole walk. */
+void swap_remove(struct swap *swap, struct spt *pages)
 {
-  struct hash_iterator i;
-  hash_first(&i, pages);
-  while(hash_next(&i)){
-    struct page *p = hash_entry(hash_cur(&i), struct page, hash_elem);
-    if(p->swap)
-      bitmap_set(swap->bitmap, p->ofs / BLOCK_PER_PG, false);
-  }
+  struct slot_batch b;
+  b.swap = swap;
+  b.cnt = 0;
+  spt_foreach(pages, swap_release, &b);
+  if(b.cnt > 0)
+    free_slots(&b);
 }
@@ -16,7 +16,8 @@ struct swap{
 void swap_init(struct swap *);
 void swap_write(struct swap *,struct frame *);
 void swap_read(struct swap *,struct page *);
-void swap_remove(struct swap *, struct hash *);
+void swap_free(struct swap *, struct page *);
+void swap_remove(struct swap *, struct spt *);
 // free swap of terminating process
 #endif
   
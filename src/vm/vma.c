@@ -0,0 +1,204 @@
+#include "vm/vma.h"
+#include <advice.h>
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Number of pages vma_read_ahead() loads past a fault. */
+#define READ_AHEAD_PAGES 8
+
+/* A process's VMAs are kept in a list sorted by start address.
+   A process has one region per ELF segment plus one per mmap, so
+   the list stays short and a linear walk beats anything fancier. */
+
+static struct kmem_cache *vma_cache;
+
+void vma_init(void)
+{
+  vma_cache = kmem_cache_create("vma", sizeof(struct vma), NULL);
+}
+
+/* Adds a region of LENGTH bytes, rounded up to whole pages, at
+   UPAGE to VMAS, backed by the first READ_BYTES bytes of FILE at
+   OFS.  Returns the new region, or NULL if it would overlap an
+   existing one or if out of memory.  The region takes over FILE,
+   which vma_destroy() does not close. */
+struct vma *vma_create(struct list *vmas, uint8_t *upage, size_t length,
+		       struct file *file, off_t ofs, uint32_t read_bytes,
+		       bool writable)
+{
+  struct list_elem *e;
+  struct vma *v;
+
+  ASSERT(pg_ofs(upage) == 0);
+  ASSERT(read_bytes <= length);
+
+  length = ROUND_UP(length, PGSIZE);
+  if(length == 0 || !is_user_vaddr(upage + length - 1)
+     || vma_overlaps(vmas, upage, length))
+    return NULL;
+  v = kmem_cache_alloc(vma_cache);
+  if(v == NULL)
+    return NULL;
+  v->start = upage;
+  v->end = upage + length;
+  v->file = read_bytes > 0 ? file : NULL;
+  v->ofs = ofs;
+  v->read_bytes = read_bytes;
+  v->writable = writable;
+  v->shared = false;
+  v->advice = ADV_NORMAL;
+
+  for(e = list_begin(vmas); e != list_end(vmas); e = list_next(e))
+    if(list_entry(e, struct vma, elem)->start > upage)
+      break;
+  list_insert(e, &v->elem);
+  return v;
+}
+
+/* Splits V at UPAGE, which must lie strictly inside it, so that
+   V ends at UPAGE, and returns the new region that covers the
+   rest, or NULL if out of memory.  Both regions share V's file.
+   Lets madvise() give part of a region its own advice. */
+struct vma *vma_split(struct vma *v, uint8_t *upage)
+{
+  uint32_t page_ofs = upage - v->start;
+  struct vma *hi;
+
+  ASSERT(pg_ofs(upage) == 0);
+  ASSERT(upage > v->start && upage < v->end);
+  hi = kmem_cache_alloc(vma_cache);
+  if(hi == NULL)
+    return NULL;
+  *hi = *v;
+  hi->start = upage;
+  hi->ofs = v->ofs + page_ofs;
+  if(v->read_bytes > page_ofs)
+    {
+      hi->read_bytes = v->read_bytes - page_ofs;
+      v->read_bytes = page_ofs;
+    }
+  else
+    {
+      hi->file = NULL;
+      hi->read_bytes = 0;
+    }
+  v->end = upage;
+  list_insert(list_next(&v->elem), &hi->elem);
+  return hi;
+}
+
+/* Removes V from its list and frees it.  Pages already faulted
+   in from V are left alone. */
+void vma_destroy(struct vma *v)
+{
+  list_remove(&v->elem);
+  kmem_cache_free(vma_cache, v);
+}
+
+/* Frees every region in VMAS. */
+void vma_destroy_all(struct list *vmas)
+{
+  while(!list_empty(vmas))
+    vma_destroy(list_entry(list_front(vmas), struct vma, elem));
+}
+
+/* Returns the region in VMAS that contains ADDR, or NULL. */
+struct vma *vma_find(struct list *vmas, const void *addr)
+{
+  struct list_elem *e;
+  for(e = list_begin(vmas); e != list_end(vmas); e = list_next(e))
+    {
+      struct vma *v = list_entry(e, struct vma, elem);
+      if((const uint8_t *) addr < v->start)
+	break;
+      if((const uint8_t *) addr < v->end)
+	return v;
+    }
+  return NULL;
+}
+
+/* Returns true if any of the LENGTH bytes at ADDR lie in a
+   region in VMAS. */
+bool vma_overlaps(struct list *vmas, const void *addr, size_t length)
+{
+  const uint8_t *start = addr, *end = start + length;
+  struct list_elem *e;
+  for(e = list_begin(vmas); e != list_end(vmas); e = list_next(e))
+    {
+      struct vma *v = list_entry(e, struct vma, elem);
+      if(v->start >= end)
+	break;
+      if(v->end > start)
+	return true;
+    }
+  return false;
+}
+
+/* Creates the page descriptor for the page of region V that
+   contains ADDR and adds it to the current process's
+   supplemental page table.  Returns NULL if out of memory. */
+struct page *vma_get_page(struct vma *v, const void *addr)
+{
+  uint8_t *upage = pg_round_down(addr);
+  uint32_t page_ofs = upage - v->start;
+  struct page *p;
+
+  ASSERT(upage >= v->start && upage < v->end);
+  p = page_create();
+  if(p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->ofs = v->ofs + page_ofs;
+  if(page_ofs < v->read_bytes)
+    {
+      p->file = v->file;
+      p->read_bytes = v->read_bytes - page_ofs < PGSIZE
+	? v->read_bytes - page_ofs : PGSIZE;
+    }
+  p->zero_bytes = PGSIZE - p->read_bytes;
+  p->writable = v->writable;
+  p->shared = v->shared;
+  p->advice = v->advice;
+  if(p->advice == ADV_NORMAL && v->file != NULL)
+    p->advice = inode_get_advice(file_get_inode(v->file));
+  if(!spt_insert(&thread_current()->pages, p))
+    {
+      page_destroy(p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Loads the file-backed pages of V that follow ADDR, up to
+   READ_AHEAD_PAGES of them, so that a sequential reader faults
+   once per batch instead of once per page.  Stops at the first
+   page that is already present or can't be loaded, and as soon
+   as there is no free user page: reading ahead by evicting would
+   push out the pages we just read ahead.  palloc_free_cnt() just
+   reads the pool's counter, so checking it per page is cheap. */
+void vma_read_ahead(struct vma *v, const void *addr)
+{
+  struct thread *t = thread_current();
+  uint8_t *upage = (uint8_t *) pg_round_down(addr) + PGSIZE;
+  int i;
+
+  for(i = 0; i < READ_AHEAD_PAGES && upage < v->end; i++, upage += PGSIZE)
+    {
+      struct page *p;
+      if(palloc_free_cnt(PAL_USER) == 0)
+	break;
+      p = page_lookup(&t->pages, upage);
+      if(p == NULL && (p = vma_get_page(v, upage)) == NULL)
+	break;
+      if(p->file == NULL || p->swap
+	 || pagedir_get_page(t->pagedir, upage) != NULL || !page_load(p))
+	break;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef VMA_H
+#define VMA_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct page;
+
+/* A virtual memory area: a page-aligned range of user memory
+   whose pages are filled from FILE on first touch.  The first
+   READ_BYTES bytes of the range come from FILE starting at OFS
+   and the rest are zeroed.  Page descriptors for a region are
+   only created when one of its pages faults, and take ADVICE
+   from the region, or from FILE if ADVICE is ADV_NORMAL. */
+struct vma{
+  struct list_elem elem;        /* Element in thread's `vmas' list. */
+  uint8_t *start;               /* First page. */
+  uint8_t *end;                 /* One past the last page. */
+  struct file *file;            /* Backing file, or NULL. */
+  off_t ofs;                    /* Offset in FILE of START. */
+  uint32_t read_bytes;          /* Bytes to read from FILE. */
+  bool writable;
+  bool shared;                  /* Write dirty pages back to FILE? */
+  int advice;                   /* ADV_* hint from madvise(). */
+};
+
+void vma_init(void);
+struct vma *vma_create(struct list *, uint8_t *upage, size_t length,
+                       struct file *, off_t ofs, uint32_t read_bytes,
+                       bool writable);
+struct vma *vma_split(struct vma *, uint8_t *upage);
+void vma_destroy(struct vma *);
+void vma_destroy_all(struct list *);
+struct vma *vma_find(struct list *, const void *);
+bool vma_overlaps(struct list *, const void *, size_t);
+struct page *vma_get_page(struct vma *, const void *);
+void vma_read_ahead(struct vma *, const void *);
+
+#endif